@@ -0,0 +1,205 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    a5bench: microbenchmark for the A5 line kernels in advent.c.
+
+    Times adv_a5_pack_line() and adv_a5_unpack() against the character at
+    a time routines they replaced (copied below as they were), after
+    checking that both give the same results on every input used.
+
+        cc -std=c99 -O2 -DADVENT_NO_MAIN advent.c a5bench.c -o a5bench
+        cc -std=c99 -O2 -mavx2 -DADVENT_NO_MAIN advent.c a5bench.c -o a5bench
+
+        ./a5bench [iterations]
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "advent.h"
+
+/* ------------------------------------------------------------------------- */
+/* The original routines                                                     */
+/* ------------------------------------------------------------------------- */
+
+static void to_upper_inplace(char *s)
+{
+    if (!s) return;
+    for (; *s; ++s)
+        *s = (char)toupper((unsigned char)*s);
+}
+
+static uint_least64_t as_a5(const char *str)
+{
+    uint_least64_t result = 0;
+    unsigned i = 0;
+    size_t len = str ? strlen(str) : 0;
+
+    while (i < len) {
+        result <<= 7;
+        result |= (uint_least64_t)(str[i] & 0x7F);
+        ++i;
+    }
+    while (i++ < 5) {
+        result <<= 7;
+        result |= (uint_least64_t)' ';
+    }
+    result <<= 1;
+    return result;
+}
+
+static void a5_to_string(uint_least64_t a, char out[6])
+{
+    int i;
+    a >>= 1;
+    for (i = 0; i < 5; ++i) {
+        out[i] = (char)((a >> ((4 - i) * 7)) & 0177);
+    }
+    out[5] = '\0';
+}
+
+static void ref_accept_4A5(const char *line, uint_least64_t a[4])
+{
+    size_t len, i, idx;
+    char upper[256];
+
+    strncpy(upper, line, sizeof(upper) - 1);
+    upper[sizeof(upper) - 1] = '\0';
+    to_upper_inplace(upper);
+
+    len = strlen(upper);
+    idx = 0;
+    for (i = 0; i < 4; ++i) {
+        char tmp[6];
+        size_t j;
+        for (j = 0; j < 5; ++j) {
+            if (idx < len)
+                tmp[j] = upper[idx++];
+            else
+                tmp[j] = ' ';
+        }
+        tmp[5] = '\0';
+        a[i] = as_a5(tmp);
+    }
+}
+
+static void ref_type_20a5(const uint_least64_t *line, int n, char *buf)
+{
+    size_t pos = 0;
+    int i;
+    for (i = 0; i < n; ++i) {
+        char tmp[6];
+        a5_to_string(line[i], tmp);
+        memcpy(buf + pos, tmp, 5);
+        pos += 5;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+#define NLINES 256
+
+static char lines[NLINES][32];
+static uint_least64_t texts[NLINES][20];
+
+static double seconds(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+static void report(const char *what, double ref, double vec, long iters)
+{
+    printf("%-8s  old %7.2f ns  new %7.2f ns  speedup %5.2fx\n", what,
+           ref * 1e9 / iters, vec * 1e9 / iters, vec > 0 ? ref / vec : 0.0);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *cmds[] = {
+        "get lamp", "xyzzy", "enter building", "throw axe", "w", "plugh",
+        "Unlock Grate", "take the golden nugget now", "", "inventory"
+    };
+    long iters = argc > 1 ? atol(argv[1]) : 2000000;
+    uint64_t sink = 0;
+    double t0, ref, vec;
+    long n;
+    int i, j;
+
+    /* commands of every length, some longer than 20 characters, and
+       lines of text words drawn from printable ASCII */
+    for (i = 0; i < NLINES; ++i) {
+        char words[100];
+        strcpy(lines[i], cmds[i % 10]);
+        if (i >= 10)
+            for (j = (int)strlen(lines[i]); j < i % 31; ++j)
+                lines[i][j] = (char)(' ' + (i * 7 + j * 13) % 95);
+        for (j = 0; j < 100; ++j)
+            words[j] = (char)(' ' + (i * 31 + j * 17) % 64);
+        for (j = 0; j < 20; ++j) {
+            char w5[6];
+            memcpy(w5, words + 5 * j, 5);
+            w5[5] = '\0';
+            texts[i][j] = as_a5(w5);
+        }
+    }
+
+    for (i = 0; i < NLINES; ++i) {
+        uint_least64_t a[4], b[4];
+        char x[100 + ADV_A5_SLACK], y[100];
+        ref_accept_4A5(lines[i], a);
+        adv_a5_pack_line(lines[i], b);
+        for (j = 1; j <= 20; ++j) {
+            ref_type_20a5(texts[i], j, y);
+            adv_a5_unpack(texts[i], j, x);
+            if (memcmp(x, y, 5 * (size_t)j) != 0) {
+                fprintf(stderr, "a5bench: unpack mismatch on line %d\n", i);
+                return EXIT_FAILURE;
+            }
+        }
+        if (memcmp(a, b, sizeof a) != 0) {
+            fprintf(stderr, "a5bench: pack mismatch on \"%s\"\n", lines[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("kernel: %s, %ld iterations\n", adv_a5_kernel(), iters);
+
+    t0 = seconds();
+    for (n = 0; n < iters; ++n) {
+        uint_least64_t a[4];
+        ref_accept_4A5(lines[n % NLINES], a);
+        sink += a[0] ^ a[3];
+    }
+    ref = seconds() - t0;
+    t0 = seconds();
+    for (n = 0; n < iters; ++n) {
+        uint_least64_t a[4];
+        adv_a5_pack_line(lines[n % NLINES], a);
+        sink += a[0] ^ a[3];
+    }
+    vec = seconds() - t0;
+    report("pack", ref, vec, iters);
+
+    t0 = seconds();
+    for (n = 0; n < iters; ++n) {
+        char buf[100 + ADV_A5_SLACK];
+        ref_type_20a5(texts[n % NLINES], 20, buf);
+        sink += (unsigned char)buf[n % 100];
+    }
+    ref = seconds() - t0;
+    t0 = seconds();
+    for (n = 0; n < iters; ++n) {
+        char buf[100 + ADV_A5_SLACK];
+        adv_a5_unpack(texts[n % NLINES], 20, buf);
+        sink += (unsigned char)buf[n % 100];
+    }
+    vec = seconds() - t0;
+    report("unpack", ref, vec, iters);
+
+    return sink == 42 ? 1 : 0;
+}
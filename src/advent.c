@@ -6,11 +6,15 @@
     Adventure (see cca.cpp in the same directory).
 
     This version:
-    - Uses only the C standard library (no C++ and no C++ standard library)
+    - Uses only the C standard library (no C++ and no C++ standard library),
+      plus mmap() where available to map world images
     - Embeds the original advdat.77-03-31 data table
     - Implements the adventure engine closely following the C++ version
 
-    This is intentionally a single C translation unit.
+    This is intentionally a single C translation unit. The engine is driven
+    one prompt at a time through adv_step() (see advent.h); main() at the
+    end of this file is the console front end. Build with -DADVENT_NO_MAIN
+    to link the engine into another program.
 */
 
 #include <stdio.h>
@@ -20,6 +24,28 @@
 #include <ctype.h>
 #include <time.h>
 
+#if defined(__unix__) || defined(__APPLE__)
+#define ADVENT_MMAP 1           /* world images are mapped, not read */
+#define ADVENT_WRITE 1          /* the console writes a turn with write() */
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define A5_KERNEL "avx2"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define A5_KERNEL "sse2"
+#else
+#define A5_KERNEL "scalar"
+#endif
+
+#include "advent.h"
+
 /* ------------------------------------------------------------------------- */
 /* Basic helpers                                                             */
 /* ------------------------------------------------------------------------- */
@@ -34,6 +60,23 @@ static void to_upper_inplace(char *s)
 /* five spaces in A5 format (PDP-10 FORTRAN IV 36-bit integer) */
 static const uint_least64_t A5_SPACE = 0201004020100ULL;
 
+/* The A5 word for characters C1..C5 as a constant expression: the same
+   value as_a5() computes, folded by the compiler. */
+#define A5_CHARS(c1, c2, c3, c4, c5)                \
+    (((uint_least64_t)((c1) & 0177) << 29) |        \
+     ((uint_least64_t)((c2) & 0177) << 22) |        \
+     ((uint_least64_t)((c3) & 0177) << 15) |        \
+     ((uint_least64_t)((c4) & 0177) << 8) |         \
+     ((uint_least64_t)((c5) & 0177) << 1))
+
+/* words the engine compares input against */
+static const uint_least64_t A5_ENTER = A5_CHARS('E', 'N', 'T', 'E', 'R');
+static const uint_least64_t A5_STREA = A5_CHARS('S', 'T', 'R', 'E', 'A');
+static const uint_least64_t A5_WATER = A5_CHARS('W', 'A', 'T', 'E', 'R');
+static const uint_least64_t A5_WEST  = A5_CHARS('W', 'E', 'S', 'T', ' ');
+static const uint_least64_t A5_NO    = A5_CHARS('N', 'O', ' ', ' ', ' ');
+static const uint_least64_t A5_N     = A5_CHARS('N', ' ', ' ', ' ', ' ');
+
 /* Return given string (0..5 chars) in PDP-10 FORTRAN IV 36-bit integer A5 format. */
 static uint_least64_t as_a5(const char *str)
 {
@@ -70,12 +113,159 @@ static void a5_to_string(uint_least64_t a, char out[6])
     out[5] = '\0';
 }
 
+/* ------------------------------------------------------------------------- */
+/* A5 line kernels                                                           */
+/* ------------------------------------------------------------------------- */
+
+/* A whole input line is packed into four A5 words and a whole line of
+   text unpacked from up to 20 in one pass, instead of one character at a
+   time through as_a5() and a5_to_string(). The vector versions are
+   chosen at compile time (-mavx2, or SSE2 which every x86-64 has); the
+   scalar ones are used everywhere else and give the same results. */
+
+const char *adv_a5_kernel(void)
+{
+    return A5_KERNEL;
+}
+
+#if defined(__SSE2__)
+/* The 8 bytes at P as a little-endian integer; only the low 5 are used. */
+static uint64_t a5_load8(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+/* Upper-case the 16 characters at P in place, as toupper() in the "C"
+   locale does: bytes outside 'a'..'z' (including those >= 0x80, which
+   compare as negative) are left alone. */
+static void a5_upper16(unsigned char *p)
+{
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('z' + 1)));
+    v = _mm_sub_epi8(v, _mm_and_si128(lower, _mm_set1_epi8(0x20)));
+    _mm_storeu_si128((__m128i *)p, v);
+}
+#endif
+
+void adv_a5_pack_line(const char *line, uint_least64_t words[4])
+{
+    unsigned char c[32];
+    size_t len;
+
+    for (len = 0; len < 20 && line[len]; ++len)
+        ;
+    memset(c, ' ', sizeof c);
+    memcpy(c, line, len);
+
+#if defined(__SSE2__)
+    a5_upper16(c);
+    a5_upper16(c + 16);
+    {
+        /* each 64-bit lane holds the five characters of one word in its
+           low bytes; shift every character into place at once */
+#if defined(__AVX2__)
+        const __m256i m = _mm256_set1_epi64x(0177);
+        __m256i v = _mm256_set_epi64x((long long)a5_load8(c + 15),
+                                      (long long)a5_load8(c + 10),
+                                      (long long)a5_load8(c + 5),
+                                      (long long)a5_load8(c));
+        __m256i r = _mm256_slli_epi64(_mm256_and_si256(v, m), 29);
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(v, 8), m), 22));
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(v, 16), m), 15));
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(v, 24), m), 8));
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(v, 32), m), 1));
+        _mm256_storeu_si256((__m256i *)words, r);
+#else
+        const __m128i m = _mm_set1_epi64x(0177);
+        int i;
+        for (i = 0; i < 4; i += 2) {
+            __m128i v = _mm_set_epi64x((long long)a5_load8(c + 5 * i + 5),
+                                       (long long)a5_load8(c + 5 * i));
+            __m128i r = _mm_slli_epi64(_mm_and_si128(v, m), 29);
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 8), m), 22));
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 16), m), 15));
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 24), m), 8));
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 32), m), 1));
+            _mm_storeu_si128((__m128i *)(words + i), r);
+        }
+#endif
+    }
+#else
+    {
+        int i, j;
+        for (i = 0; i < 20; ++i)
+            if (c[i] >= 'a' && c[i] <= 'z')
+                c[i] = (unsigned char)(c[i] - 0x20);
+        for (i = 0; i < 4; ++i) {
+            uint_least64_t a = 0;
+            for (j = 0; j < 5; ++j)
+                a = (a << 7) | (c[5 * i + j] & 0177);
+            words[i] = a << 1;
+        }
+    }
+#endif
+}
+
+void adv_a5_unpack(const uint_least64_t *words, int n, char *out)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    /* each 64-bit lane turns one word into its five characters in the low
+       bytes; the 8-byte stores overlap, each one's three spare bytes being
+       overwritten by the next (or left in the slack after the last) */
+#if defined(__AVX2__)
+    const __m256i m4 = _mm256_set1_epi64x(0177);
+    for (; i + 4 <= n; i += 4) {
+        uint64_t lane[4];
+        int k;
+        __m256i v = _mm256_srli_epi64(_mm256_loadu_si256((const __m256i *)(words + i)), 1);
+        __m256i r = _mm256_and_si256(_mm256_srli_epi64(v, 28), m4);
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(v, 21), m4), 8));
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(v, 14), m4), 16));
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(_mm256_srli_epi64(v, 7), m4), 24));
+        r = _mm256_or_si256(r, _mm256_slli_epi64(_mm256_and_si256(v, m4), 32));
+        _mm256_storeu_si256((__m256i *)lane, r);
+        for (k = 0; k < 4; ++k)
+            memcpy(out + 5 * (i + k), &lane[k], 8);
+    }
+#endif
+    {
+        const __m128i m = _mm_set1_epi64x(0177);
+        for (; i + 2 <= n; i += 2) {
+            uint64_t lane[2];
+            __m128i v = _mm_srli_epi64(_mm_loadu_si128((const __m128i *)(words + i)), 1);
+            __m128i r = _mm_and_si128(_mm_srli_epi64(v, 28), m);
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 21), m), 8));
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 14), m), 16));
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(_mm_srli_epi64(v, 7), m), 24));
+            r = _mm_or_si128(r, _mm_slli_epi64(_mm_and_si128(v, m), 32));
+            _mm_storeu_si128((__m128i *)lane, r);
+            memcpy(out + 5 * i, &lane[0], 8);
+            memcpy(out + 5 * i + 5, &lane[1], 8);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        uint_least64_t t = words[i] >> 1;
+        char *p = out + 5 * i;
+        p[0] = (char)(t >> 28 & 0177);
+        p[1] = (char)(t >> 21 & 0177);
+        p[2] = (char)(t >> 14 & 0177);
+        p[3] = (char)(t >> 7 & 0177);
+        p[4] = (char)(t & 0177);
+    }
+}
+
 /* ------------------------------------------------------------------------- */
 /* Embedded advdat.77-03-31 data (taken from cca.cpp)                        */
 /* ------------------------------------------------------------------------- */
 
 /* The contents of the text file http://www.icynic.com/~don/jerz/advdat.77-03-31 */
-static const char advdat_77_03_31[] =
+const char advdat_77_03_31[] =
 "1\n"
 "1    YOU ARE STANDING AT THE END OF A ROAD BEFORE A SMALL BRICK\n"
 "1    BUILDING . AROUND YOU IS A FOREST. A SMALL\n"
@@ -812,36 +1002,77 @@ static const char advdat_77_03_31[] =
 /* Simple console I/O abstraction (replacement for scaffolding::advent_io)   */
 /* ------------------------------------------------------------------------- */
 
-static void io_type_str(const char *s)
+/* Append the LEN bytes at STR to the output of the current adv_step(),
+   growing the session's arena geometrically when it is full. */
+static void io_type_mem(struct adv_session *s, const char *str, size_t len)
+{
+    if (s->events)
+        return;
+    if (s->outlen + len + 1 > s->outcap) {
+        size_t cap = s->outcap ? s->outcap : ADV_OUTPUT_SIZE;
+        char *out;
+        while (cap < s->outlen + len + 1)
+            cap *= 2;
+        out = realloc(s->out, cap);
+        if (!out) {
+            fprintf(stderr, "io_type_mem(): out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        s->out = out;
+        s->outcap = cap;
+    }
+    memcpy(s->out + s->outlen, str, len);
+    s->outlen += len;
+    s->out[s->outlen] = '\0';
+}
+
+static void io_type_str(struct adv_session *s, const char *str)
 {
-    fputs(s, stdout);
+    io_type_mem(s, str, strlen(str));
 }
 
-static void io_type_int(int n)
+static void io_type_int(struct adv_session *s, int n)
 {
     char buf[32];
     snprintf(buf, sizeof(buf), "%d", n);
-    fputs(buf, stdout);
+    io_type_str(s, buf);
 }
 
-static void io_getline(char *buf, size_t bufsize)
+/* Record event KIND with ARG if S is headless. */
+static void io_event(struct adv_session *s, int kind, int arg)
 {
-    if (!fgets(buf, (int)bufsize, stdin)) {
-        /* treat EOF as empty line */
-        buf[0] = '\0';
-        return;
-    }
-    /* strip trailing newline */
-    size_t len = strlen(buf);
-    if (len > 0 && buf[len - 1] == '\n')
-        buf[len - 1] = '\0';
+    if (s->events && s->evlen < s->evsize)
+        s->events[s->evlen++] = (uint16_t)(kind << 12 | (arg & 07777));
 }
 
-static double io_ran(int dummy)
+/* SplitMix64 output function. */
+static uint64_t mix64(uint64_t z)
 {
-    /* Simple PRNG wrapper using rand()/RAND_MAX */
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Return the next number in [0, 1) of the session's random stream. The
+   n-th number drawn depends only on the seed and n, so a game is exactly
+   reproducible from its seed and its commands, whatever the thread or
+   machine. */
+static double io_ran(struct adv_session *s, int dummy)
+{
+    uint64_t z;
     (void)dummy;
-    return (double)rand() / (double)RAND_MAX;
+    z = mix64(s->ran_seed + ++s->ran_count * 0x9E3779B97F4A7C15ULL);
+    return (double)(z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Whether the random event at SITE (a statement label of cca.cpp), which
+   happens with probability P, happens: decided by the session's chance
+   function if it has one, else by the stream. */
+static int io_chance(struct adv_session *s, int site, double p)
+{
+    if (s->chance)
+        return s->chance(s->chance_ctx, site, p) != 0;
+    return io_ran(s, site) < p;
 }
 
 static void io_trace_location(int loc)
@@ -851,7 +1082,7 @@ static void io_trace_location(int loc)
 }
 
 /* ------------------------------------------------------------------------- */
-/* Core helpers that correspond to Crowther::shift, getin, type_20a5, etc.   */
+/* Core helpers that correspond to Crowther::shift, getin, etc.             */
 /* ------------------------------------------------------------------------- */
 
 /* Shift 36-bit unsigned integer VAL by DIST bits (positive: left, negative: right). */
@@ -863,87 +1094,73 @@ static void shift36(uint_least64_t val, int dist, uint_least64_t *res)
         *res = (val << dist) & 0777777777777ULL;
 }
 
-/* Output a FORTRAN 4 (5 chars per 36-bit word) line segment. */
-static void type_20a5(
-    const uint_least64_t line[23],
-    uint_least64_t begin,
-    uint_least64_t end)
+/* Output the message whose first line is KK: its lines as decoded into
+   the text pool at load, and the blank line after them. */
+static void type_text(struct adv_session *s, int kk)
 {
-    char buf[23 * 5 + 2];
-    size_t pos = 0;
-    uint_least64_t i;
-    for (i = begin; i <= end; ++i) {
-        char tmp[6];
-        a5_to_string(line[i], tmp);
-        memcpy(buf + pos, tmp, 5);
-        pos += 5;
-    }
-    buf[pos++] = '\n';
-    buf[pos] = '\0';
-    io_type_str(buf);
+    const struct adv_world *w = s->w;
+
+    io_type_mem(s, w->text + w->text_off[kk], w->text_len[kk]);
 }
 
-/* ACCEPT 4A5 equivalent: read user line and split into 4 A5 words. */
-static void accept_4A5(uint_least64_t a[6])
+/* ACCEPT 4A5 equivalent: split user LINE into 4 A5 words. */
+static void accept_4A5(const char *line, uint_least64_t a[6])
 {
-    char line[256];
-    size_t len, i, idx;
-    char upper[256];
-
-    io_getline(line, sizeof(line));
-    strncpy(upper, line, sizeof(upper) - 1);
-    upper[sizeof(upper) - 1] = '\0';
-    to_upper_inplace(upper);
-
     a[0] = 9999; /* unused */
-    for (i = 1; i <= 4; ++i)
-        a[i] = A5_SPACE;
+    adv_a5_pack_line(line, a + 1);
     a[5] = A5_SPACE;
+}
 
-    len = strlen(upper);
-    idx = 0;
-    for (i = 0; i < 4; ++i) {
-        char tmp[6];
-        size_t j;
-        for (j = 0; j < 5; ++j) {
-            if (idx < len)
-                tmp[j] = upper[idx++];
-            else
-                tmp[j] = ' ';
-        }
-        tmp[5] = '\0';
-        a[i + 1] = as_a5(tmp);
-    }
+static void pause_prompt(struct adv_session *s)
+{
+    io_type_str(s,
+        "TO RESUME EXECUTION, TYPE: G\n"
+        "TO TERMINATE THE PROGRAM, TYPE: X\n");
+    s->prompt = ADV_PROMPT_PAUSE;
 }
 
-/* Display the PAUSE text and wait for the user to type G or X. */
-static void pause_game(const char *msg)
+static const char *const pause_msg[] = {
+    "INIT DONE", "GAME OVER", "GAMES OVER", "GAME IS OVER",
+    "NO NO", "ERROR 5", "OOPS"
+};
+
+/* Display the PAUSE text for WHY; the user must then type G or X. Once
+   they type G the game carries on at NEXT (see adv_step()). */
+static void pause_game(struct adv_session *s, enum adv_pause why, int next)
 {
-    char input[64];
+    io_event(s, ADV_EV_PAUSE, why);
+    io_type_str(s, "PAUSE: ");
+    io_type_str(s, pause_msg[why]);
+    io_type_str(s, "\n");
+    pause_prompt(s);
+    s->next = next;
+}
 
-    io_type_str("PAUSE: ");
-    io_type_str(msg);
-    io_type_str("\n");
+/* Answer INPUT to a pause: 1 to resume, 0 if the game is over, -1 to ask
+   again. */
+static int pause_answer(struct adv_session *s, const char *input)
+{
+    char upper[64];
 
-    for (;;) {
-        io_type_str(
-            "TO RESUME EXECUTION, TYPE: G\n"
-            "TO TERMINATE THE PROGRAM, TYPE: X\n");
-        io_getline(input, sizeof(input));
-        to_upper_inplace(input);
-        if (strcmp(input, "G") == 0) {
-            io_type_str("EXECUTION RESUMED\n\n");
-            break;
-        }
-        if (strcmp(input, "X") == 0) {
-            io_type_str("EXECUTION TERMINATED.\n");
-            exit(EXIT_FAILURE);
-        }
+    strncpy(upper, input, sizeof(upper) - 1);
+    upper[sizeof(upper) - 1] = '\0';
+    to_upper_inplace(upper);
+    if (strcmp(upper, "G") == 0) {
+        io_type_str(s, "EXECUTION RESUMED\n\n");
+        return 1;
+    }
+    if (strcmp(upper, "X") == 0) {
+        io_type_str(s, "EXECUTION TERMINATED.\n");
+        s->prompt = ADV_PROMPT_OVER;
+        return 0;
     }
+    pause_prompt(s);
+    return -1;
 }
 
-/* GETIN: parse up to two words from user input in A5 format. */
+/* GETIN: parse up to two words from user input LINE in A5 format. */
 static void getin(
+    const char *line,
     uint_least64_t *twow,
     uint_least64_t *b,
     uint_least64_t *c,
@@ -957,7 +1174,7 @@ static void getin(
         9999ULL,04000000000ULL,020000000ULL,0100000ULL,0400ULL,02ULL,0ULL
     };
 
-    accept_4A5(a);
+    accept_4A5(line, a);
 
     *twow = 0;
     s = 0;
@@ -1004,52 +1221,60 @@ L4:
 
 /* Arrays are sized according to original FORTRAN/C++ declarations. */
 
-static int dloc[11], dseen[11], odloc[11];
-static int tk[26];
-static int ichain[101], ifixed[101], iplace[101], prop[101], rtext_tab[101];
-static int btext[201];
-static int abb[301], cond[301], default_[301], iobj[301], key[301], ltext[301], stext[301];
-static int ktab[1001], travel[1001];
-static uint_least64_t lline[1001][23];      /* description text table */
-static uint_least64_t atab[1001];           /* keyword table */
-
 /* JSPKT, IPLT, IFIXT, DTRAV initial values taken from cca.cpp */
-static int jspkt[101] = {
+static const int jspkt[101] = {
     9999,24,29,0,31,0,31,38,38,42,42,43,46,77,71,73,75
 };
 
-static int iplt[101] = {
+static const int iplt[101] = {
     9999,3,3,8,10,11,14,13,9,15,18,19,17,27,28,29,30,0,0,3,3
 };
 
-static int ifixt[101] = {
+static const int ifixt[101] = {
     9999,0,0,1,0,0,1,0,1,1,0,1,1
 };
 
-static int dtrav[21] = {
+static const int dtrav[21] = {
     9999,36,28,19,30,62,60,41,27,17,15,19,28,36,300,300
 };
 
+/* idwarf stops here: from 22 on, 2 * i + idwarf > 23 for every dwarf and
+   dtrav[i * 2 + idwarf - 8] is past the routes, 0, so the game goes on as
+   it would with idwarf counting up, without reading past dtrav. */
+#define IDWARF_MAX 22
+
 /* ------------------------------------------------------------------------- */
 /* Parsing helpers for advdat_77_03_31                                       */
 /* ------------------------------------------------------------------------- */
 
-static const char *advdat_p = advdat_77_03_31;
-
-/* Read next line from embedded advdat into buf (without trailing '\n'). */
-static int advdat_read_line(char *buf, size_t bufsize)
+/* Read next non-blank line of advdat text at *cur into buf (without
+   trailing '\n') and advance *cur past it. */
+static int advdat_read_line(const char **cur, char *buf, size_t bufsize)
 {
+    const char *p = *cur;
     size_t i = 0;
-    if (!advdat_p || *advdat_p == '\0') {
+
+    /* skip blank lines, as found in some of the advdat files in doc/ */
+    while (p) {
+        const char *q = p;
+        while (*q == ' ' || *q == '\t')
+            ++q;
+        if (*q != '\n')
+            break;
+        p = q + 1;
+    }
+
+    if (!p || *p == '\0') {
         buf[0] = '\0';
         return 0;
     }
-    while (*advdat_p && *advdat_p != '\n' && i + 1 < bufsize) {
-        buf[i++] = *advdat_p++;
+    while (*p && *p != '\n' && i + 1 < bufsize) {
+        buf[i++] = *p++;
     }
-    if (*advdat_p == '\n')
-        advdat_p++;
+    if (*p == '\n')
+        p++;
     buf[i] = '\0';
+    *cur = p;
     return 1;
 }
 
@@ -1070,14 +1295,14 @@ static int parse_first_int(const char *line, int *value)
 }
 
 /* rdmap: FORMAT(12G) equivalent */
-static void rdmap(int *jkind, int *lkind, int tk_local[26])
+static void rdmap(const char **cur, int *jkind, int *lkind, int tk_local[26])
 {
     char line[256];
     int vals[12];
     int count = 0;
     const char *p;
 
-    if (!advdat_read_line(line, sizeof(line))) {
+    if (!advdat_read_line(cur, line, sizeof(line))) {
         fprintf(stderr, "rdmap(): unexpected end of advdat\n");
         exit(EXIT_FAILURE);
     }
@@ -1112,12 +1337,12 @@ static void rdmap(int *jkind, int *lkind, int tk_local[26])
 }
 
 /* rdtext: FORMAT(1G,20A5) equivalent */
-static void rdtext(int *j, uint_least64_t t[23])
+static void rdtext(const char **cur, int *j, uint_least64_t t[23])
 {
     char line[512];
     char *p;
 
-    if (!advdat_read_line(line, sizeof(line))) {
+    if (!advdat_read_line(cur, line, sizeof(line))) {
         fprintf(stderr, "rdtext(): unexpected end of advdat\n");
         exit(EXIT_FAILURE);
     }
@@ -1130,7 +1355,7 @@ static void rdtext(int *j, uint_least64_t t[23])
     /* move p to after the integer */
     p = line;
     (void)strtol(p, &p, 10);
-    while (*p == ' ')
+    while (*p == ' ' || *p == '\t')
         ++p;
 
     t[0] = 9999;
@@ -1153,19 +1378,19 @@ static void rdtext(int *j, uint_least64_t t[23])
             len -= copy;
         }
         while (n < 23)
-            t[n++] = as_a5("");
+            t[n++] = A5_SPACE;
     }
 }
 
 /* rdkey: FORMAT(G,A5) equivalent */
-static void rdkey(int *k, uint_least64_t *a)
+static void rdkey(const char **cur, int *k, uint_least64_t *a)
 {
     char line[128];
     char *p;
     char word[6];
     size_t i;
 
-    if (!advdat_read_line(line, sizeof(line))) {
+    if (!advdat_read_line(cur, line, sizeof(line))) {
         fprintf(stderr, "rdkey(): unexpected end of advdat\n");
         exit(EXIT_FAILURE);
     }
@@ -1177,7 +1402,7 @@ static void rdkey(int *k, uint_least64_t *a)
 
     p = line;
     (void)strtol(p, &p, 10);
-    while (*p == ' ')
+    while (*p == ' ' || *p == '\t')
         ++p;
 
     for (i = 0; i < 5; ++i) {
@@ -1190,95 +1415,539 @@ static void rdkey(int *k, uint_least64_t *a)
     *a = as_a5(word);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Vocabulary hash                                                           */
+/* ------------------------------------------------------------------------- */
+
+/* The vocabulary is looked up through a minimal perfect hash built when
+   the world is loaded (hash, displace and compress): each distinct word
+   in atab gets its own slot in vocab_slot[0..vocab_n-1]. A word hashes to
+   a bucket, whose displacement pair places it in its slot, so a lookup
+   costs two multiplications and a single compare whatever the size of
+   the vocabulary. */
+
+static uint64_t vocab_hash(const struct adv_world *w, uint_least64_t word)
+{
+    return mix64((uint64_t)word ^ w->vocab_salt);
+}
+
+static unsigned vocab_slot_of(const struct adv_world *w, uint64_t h,
+                              unsigned d0, unsigned d1)
+{
+    uint64_t m = (uint64_t)w->vocab_n;
+    uint64_t f1 = (h & 0xFFFFFFFFULL) % m;
+    uint64_t f2 = (h >> 32 & 0xFFFFFULL) % m;
+    return (unsigned)((f1 + d0 * f2 + d1) % m);
+}
+
+/* Return the first index i with atab[i] == WORD, or 0 if it is not in the
+   vocabulary. Same result as scanning ktab/atab up to the -1 marker. */
+static int vocab_find(const struct adv_world *w, uint_least64_t word)
+{
+    uint64_t h;
+    const uint16_t *d;
+    int i;
+
+    if (w->vocab_n == 0)
+        return 0;
+    h = vocab_hash(w, word);
+    d = w->vocab_disp[(h >> 52) % (unsigned)w->vocab_buckets];
+    i = w->vocab_slot[vocab_slot_of(w, h, d[0], d[1])];
+    return w->atab[i] == word ? i : 0;
+}
+
+/* Try to build the hash with the current vocab_salt. */
+static int vocab_try(struct adv_world *w, const int *words, int n)
+{
+    int bucket_of[1000], order[ADV_VOCAB_BUCKETS], size[ADV_VOCAB_BUCKETS];
+    uint64_t hash[1000];
+    unsigned char used[1000];
+    int i, b, nb = w->vocab_buckets;
+
+    memset(size, 0, sizeof(size));
+    for (i = 0; i < n; ++i) {
+        hash[i] = vocab_hash(w, w->atab[words[i]]);
+        bucket_of[i] = (int)((hash[i] >> 52) % (unsigned)nb);
+        ++size[bucket_of[i]];
+    }
+
+    /* place the biggest buckets first, while most slots are still free */
+    for (b = 0; b < nb; ++b)
+        order[b] = b;
+    for (b = 1; b < nb; ++b) {
+        int t = order[b], c = b;
+        while (c > 0 && size[order[c - 1]] < size[t]) {
+            order[c] = order[c - 1];
+            --c;
+        }
+        order[c] = t;
+    }
+
+    memset(used, 0, sizeof(used));
+    for (b = 0; b < nb && size[order[b]] > 0; ++b) {
+        int bk = order[b];
+        unsigned d0, d1, slots[1000];
+        for (d0 = 0; d0 < (unsigned)n; ++d0) {
+            for (d1 = 0; d1 < (unsigned)n; ++d1) {
+                int k = 0, ok = 1;
+                for (i = 0; i < n && ok; ++i) {
+                    int c;
+                    if (bucket_of[i] != bk)
+                        continue;
+                    slots[k] = vocab_slot_of(w, hash[i], d0, d1);
+                    if (used[slots[k]])
+                        ok = 0;
+                    for (c = 0; c < k && ok; ++c)
+                        if (slots[c] == slots[k])
+                            ok = 0;
+                    ++k;
+                }
+                if (ok)
+                    goto placed;
+            }
+        }
+        return 0;
+
+placed:
+        w->vocab_disp[bk][0] = (uint16_t)d0;
+        w->vocab_disp[bk][1] = (uint16_t)d1;
+        for (i = 0; i < n; ++i) {
+            if (bucket_of[i] != bk)
+                continue;
+            used[vocab_slot_of(w, hash[i], d0, d1)] = 1;
+            w->vocab_slot[vocab_slot_of(w, hash[i], d0, d1)] = (uint16_t)words[i];
+        }
+    }
+    return 1;
+}
+
+/* Build the vocabulary hash from ktab/atab. */
+static void vocab_build(struct adv_world *w)
+{
+    int words[1000];
+    int i, c, n = 0;
+
+    /* distinct words only: a lookup must find the first of duplicates
+       such as ROCK or KNIFE, as the linear scan at L2023 did */
+    for (i = 1; i <= 1000 && w->ktab[i] != -1; ++i) {
+        for (c = 0; c < n; ++c)
+            if (w->atab[words[c]] == w->atab[i])
+                break;
+        if (c == n)
+            words[n++] = i;
+    }
+
+    w->vocab_n = n;
+    w->vocab_buckets = n / 4 + 1;
+    if (n == 0)
+        return;
+    for (w->vocab_salt = 0; !vocab_try(w, words, n); ++w->vocab_salt)
+        memset(w->vocab_disp, 0, sizeof(w->vocab_disp));
+}
+
+/* ------------------------------------------------------------------------- */
+/* Motion table                                                              */
+/* ------------------------------------------------------------------------- */
+
+/* Where verb K leads from LOC by walking LOC's travel entries, as L9 did:
+   the first entry for K or for 1 (any verb) wins; 0 if none does. */
+static int travel_walk(const struct adv_world *w, int loc, int k)
+{
+    int kk = w->key[loc];
+    int ll;
+
+    if (kk == 0)
+        return 0;
+    for (;; ++kk) {
+        ll = w->travel[kk];
+        if (ll < 0)
+            ll = -ll;
+        if (ll % 1024 == 1 || ll % 1024 == k)
+            return ll / 1024;
+        if (w->travel[kk] < 0)
+            return 0;
+    }
+}
+
+/* Fill in w->motion from key and travel. */
+static void motion_build(struct adv_world *w)
+{
+    int loc, k;
+
+    for (loc = 1; loc <= 300; ++loc) {
+        if (w->key[loc] == 0)
+            continue;
+        for (k = 0; k < ADV_MOTIONS; ++k)
+            w->motion[loc][k] = (uint16_t)travel_walk(w, loc, k);
+    }
+}
+
+int adv_world_exit(const struct adv_world *w, int loc, int k)
+{
+    if (loc < 0 || loc > 300)
+        return 0;
+    if (k >= 0 && k < ADV_MOTIONS)
+        return w->motion[loc][k];
+    return travel_walk(w, loc, k);
+}
+
+/* The rooms each special case of L21 (301..315) can lead to, whatever
+   the state and the random numbers; 306 starts the game over in room 1.
+   Keep in step with L22..L39. */
+static const short special_rooms[15][3] = {
+    { 6,  5}, {23,  9}, { 9,  8}, {20, 15}, {22, 14}, { 1},     {27, 31},
+    {28, 32}, {29, 32}, {30, 32}, { 8,  9}, {68, 65}, {39, 70, 65},
+    {66, 71, 72}, {66, 77}
+};
+
+int adv_world_adjacent(const struct adv_world *w, int loc, int *rooms, int max)
+{
+    unsigned char found[301] = {0};
+    int n = 0, kk, ll, i;
+
+    if (loc < 1 || loc > 300 || w->key[loc] == 0)
+        return 0;
+    for (kk = w->key[loc];; ++kk) {
+        ll = w->travel[kk] < 0 ? -w->travel[kk] : w->travel[kk];
+        ll /= 1024;
+        for (i = 0; i < 3; ++i) {
+            int to = ll > 300 && ll <= 315 ? special_rooms[ll - 301][i]
+                   : i == 0 && ll < 300 ? ll : 0;
+            if (to == 0 || found[to])
+                continue;
+            found[to] = 1;
+            if (n < max)
+                rooms[n] = to;
+            ++n;
+        }
+        if (w->travel[kk] < 0)
+            break;
+    }
+    return n;
+}
+
 /* ------------------------------------------------------------------------- */
 /* SPEAK and YES subroutines                                                 */
 /* ------------------------------------------------------------------------- */
 
-static void speak(int it)
+static void speak(struct adv_session *s, int it)
 {
+    const struct adv_world *w = s->w;
     int kkt;
 
-    kkt = rtext_tab[it];
+    kkt = w->rtext_tab[it];
     if (kkt == 0)
         return;
-L999:
-    type_20a5(lline[kkt], 3, lline[kkt][2]);
-    ++kkt;
-    if (lline[kkt - 1][1] != 0)
-        goto L999;
-    io_type_str("\n");
+    if (s->events) {
+        io_event(s, ADV_EV_SPEAK, it);
+        return;
+    }
+    type_text(s, kkt);
+}
+
+/* Ask yes/no question X; the answer is handled by yes_answer(). */
+static void yes_sub(struct adv_session *s, int x, int y, int z, int next)
+{
+    speak(s, x);
+    s->yes_y = y;
+    s->yes_z = z;
+    s->next = next;
+    s->prompt = ADV_PROMPT_YES;
 }
 
-static void yes_sub(int x, int y, int z, int *yea)
+/* Take INPUT as the answer to the pending yes/no question: set yea and
+   speak the matching reply. */
+static void yes_answer(struct adv_session *s, const char *input)
 {
     uint_least64_t junk, ia1, ib1;
     uint_least64_t twow;
 
-    speak(x);
-    getin(&twow, &ia1, &junk, &ib1);
+    getin(input, &twow, &ia1, &junk, &ib1);
 
-    if (ia1 == as_a5("NO") || ia1 == as_a5("N"))
+    if (ia1 == A5_NO || ia1 == A5_N)
         goto L1;
 
-    *yea = 1;
-    if (y != 0)
-        speak(y);
+    s->g.yea = 1;
+    if (s->yes_y != 0)
+        speak(s, s->yes_y);
     return;
 
 L1:
-    *yea = 0;
-    if (z != 0)
-        speak(z);
+    s->g.yea = 0;
+    if (s->yes_z != 0)
+        speak(s, s->yes_z);
 }
 
 /* ------------------------------------------------------------------------- */
-/* Core adventure routine (heavily based on Crowther::adventure in cca.cpp). */
+/* State hash                                                                */
+/* ------------------------------------------------------------------------- */
+
+/* g->hash is the XOR of a key for each (field, index, value) of the state
+   that decides where play can go: where the objects are and what state
+   they are in, where the player and the dwarves are, whether it is dark,
+   the dwarf and trouble counters, the verb or object of a command still
+   waiting for the other, and the second word of the last command (a later
+   ENTER alone still looks at it). Counters that only change the messages
+   printed (abb, idetal, iwest), the order objects are listed in and the
+   random number stream are left out. Each key is a function of its triple
+   rather than a table entry, and a field is only ever changed through
+   game_set() or obj_move() (or by getin(), for the second word), which XOR
+   out the old key and in the new, so the hash costs a couple of
+   multiplies per change. */
+enum game_field {
+    GF_PLACE = 1,   /* iplace[idx] */
+    GF_PROP,        /* prop[idx] */
+    GF_LOC,
+    GF_LOLD,
+    GF_DLOC,        /* dloc[idx] */
+    GF_ODLOC,       /* odloc[idx] */
+    GF_DSEEN,       /* dseen[idx] */
+    GF_IDWARF,
+    GF_LTRUBL,
+    GF_IDARK,
+    GF_JVERB,       /* a verb given alone waits for its object */
+    GF_JOBJ,
+    GF_WD2          /* not an int: see game_word() */
+};
+
+static uint64_t game_key(enum game_field f, int idx, int val)
+{
+    return mix64(((uint64_t)f << 48 | (uint64_t)idx << 32 | (uint32_t)val)
+                 ^ 0x243F6A8885A308D3ULL);
+}
+
+static int *game_field(struct adv_game *g, enum game_field f, int idx)
+{
+    switch (f) {
+    case GF_PLACE:  return &g->iplace[idx];
+    case GF_PROP:   return &g->prop[idx];
+    case GF_LOC:    return &g->loc;
+    case GF_LOLD:   return &g->lold;
+    case GF_DLOC:   return &g->dloc[idx];
+    case GF_ODLOC:  return &g->odloc[idx];
+    case GF_DSEEN:  return &g->dseen[idx];
+    case GF_IDWARF: return &g->idwarf;
+    case GF_LTRUBL: return &g->ltrubl;
+    case GF_IDARK:  return &g->idark;
+    case GF_JVERB:  return &g->jverb;
+    case GF_JOBJ:   return &g->jobj;
+    case GF_WD2:    break;
+    }
+    return NULL;
+}
+
+/* Set field F (element IDX of it) of the game in S to VAL. Not for
+   iplace, which only obj_move() changes. */
+static void game_set(struct adv_session *s, enum game_field f, int idx, int val)
+{
+    int *p = game_field(&s->g, f, idx);
+
+    if (!s->unhashed)
+        s->g.hash ^= game_key(f, idx, *p) ^ game_key(f, idx, val);
+    *p = val;
+}
+
+/* The keys for W as the second word, one for each half of it. */
+static uint64_t game_word(uint_least64_t w)
+{
+    return game_key(GF_WD2, 0, (int)(uint32_t)w)
+         ^ game_key(GF_WD2, 1, (int)(uint32_t)(w >> 32));
+}
+
+/* The hash of G computed from scratch. */
+static uint64_t game_hash(const struct adv_game *g)
+{
+    struct adv_game *fields = (struct adv_game *)g;   /* only read */
+    uint64_t h = 0;
+    int f, i;
+
+    for (i = 1; i < ADV_OBJECTS; ++i) {
+        h ^= game_key(GF_PLACE, i, g->iplace[i]);
+        h ^= game_key(GF_PROP, i, g->prop[i]);
+    }
+    for (f = GF_LOC; f <= GF_JOBJ; ++f) {
+        if (f == GF_DLOC || f == GF_ODLOC || f == GF_DSEEN) {
+            for (i = 1; i <= 3; ++i)
+                h ^= game_key((enum game_field)f, i, *game_field(fields, (enum game_field)f, i));
+        } else {
+            h ^= game_key((enum game_field)f, 0, *game_field(fields, (enum game_field)f, 0));
+        }
+    }
+    return h ^ game_word(g->wd2);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Object placement                                                          */
 /* ------------------------------------------------------------------------- */
 
-static void adventure(void)
+/* iplace[] says where each object is: a room, -1 if carried, 0 or 300 if
+   nowhere. The bitsets here[] and held say the same the other way round,
+   so a room's contents are one load and moving an object is a few bit
+   operations rather than a walk down a linked list. */
+
+#define OBJ_BIT(obj) ((uint32_t)1 << (obj))
+
+/* Move OBJ of G from wherever it is to PLACE, leaving the hash as it
+   is. In a room it is listed before everything already there, as the
+   original pushed it onto the head of the room's chain. */
+static void obj_place(struct adv_game *g, int obj, int place)
+{
+    int from = g->iplace[obj];
+
+    if (from == -1)
+        g->held &= ~OBJ_BIT(obj);
+    else if (from > 0 && from < 300)
+        g->here[from] &= ~OBJ_BIT(obj);
+
+    g->iplace[obj] = place;
+    if (place == -1) {
+        g->held |= OBJ_BIT(obj);
+    } else if (place > 0 && place < 300) {
+        g->here[place] |= OBJ_BIT(obj);
+        g->stamp[obj] = ++g->nstamp;
+    }
+}
+
+/* Move OBJ of the game in S to PLACE, as obj_place(). */
+static void obj_move(struct adv_session *s, int obj, int place)
 {
-    int attack, dtot, id, idark, idetal, idwarf,
-        ifirst, ikind, iid, il, ilk, ilong, itemp, iwest;
-    int j, jkind, jobj, jverb, k, kk, kq, ktem, l, lkind, ll, loc, lold, ltrubl,
-        stick, temp, yea, jspk;
-    uint_least64_t a, b, twowds, wd2;
+    if (!s->unhashed)
+        s->g.hash ^= game_key(GF_PLACE, obj, s->g.iplace[obj]) ^ game_key(GF_PLACE, obj, place);
+    obj_place(&s->g, obj, place);
+}
 
+/* Set G up as the game starts: the objects where iplt puts them, listed
+   in ascending order within a room, and the flags L1100 sets. */
+static void game_start(struct adv_game *g)
+{
     int i;
 
-    /* item index constants (matching cca.cpp) */
-    const int keys      = 1;
-    const int lamp      = 2;
-    const int grate     = 3;
-    const int rod       = 5;
-    const int bird      = 7;
-    const int nugget    = 10;
-    const int snake     = 11;
-    const int food      = 19;
-    const int water     = 20;
-    const int axe       = 21;
+    memset(g, 0, sizeof(*g));
+    for (i = 1; i < ADV_OBJECTS; ++i) {
+        obj_place(g, i, iplt[i]);
+        g->stamp[i] = ADV_OBJECTS - i;
+    }
+    g->nstamp = ADV_OBJECTS;
+    g->idwarf = 0;
+    g->ifirst = 1;
+    g->iwest = 0;
+    g->ilong = 1;
+    g->idetal = 0;
+    g->hash = game_hash(g);
+}
+
+/* Start the game in S over at L1100 as the original did: the objects go
+   back where they start and the flags L1100 sets are set again, while
+   prop, abb, the dwarves and the rest stay as they were. A new session
+   is already at w->start, so for the first game this changes nothing. */
+static void game_restart(struct adv_session *s)
+{
+    const struct adv_game *start = &s->w->start;
+    struct adv_game *g = &s->g;
+
+    memcpy(g->iplace, start->iplace, sizeof(g->iplace));
+    memcpy(g->here, start->here, sizeof(g->here));
+    g->held = start->held;
+    memcpy(g->stamp, start->stamp, sizeof(g->stamp));
+    g->nstamp = start->nstamp;
+    g->idwarf = start->idwarf;
+    g->ifirst = start->ifirst;
+    g->iwest = start->iwest;
+    g->ilong = start->ilong;
+    g->idetal = start->idetal;
+    if (!s->unhashed)
+        g->hash = game_hash(g);
+}
+
+/* Write the objects in ROOM to LIST in the order the room lists them and
+   return how many there are. */
+static int obj_list(const struct adv_game *g, int room, int list[ADV_OBJECTS])
+{
+    uint32_t bits = g->here[room];
+    int n = 0;
+    int obj, k;
+
+    for (obj = 1; obj < ADV_OBJECTS; ++obj) {
+        if (!(bits & OBJ_BIT(obj)))
+            continue;
+        for (k = n; k > 0 && g->stamp[list[k - 1]] < g->stamp[obj]; --k)
+            list[k] = list[k - 1];
+        list[k] = obj;
+        ++n;
+    }
+    return n;
+}
+
+/* The lowest numbered object in BITS, which is not empty. */
+static int obj_lowest(uint32_t bits)
+{
+    int obj = 0;
 
-    /* Initialize tables that are implicitly zeroed in FORTRAN/C++ */
-    memset(dloc, 0, sizeof(dloc));
-    memset(dseen, 0, sizeof(dseen));
-    memset(odloc, 0, sizeof(odloc));
-    memset(tk,   0, sizeof(tk));
-    memset(ichain, 0, sizeof(ichain));
-    memset(ifixed, 0, sizeof(ifixed));
-    memset(iplace, 0, sizeof(iplace));
-    memset(prop, 0, sizeof(prop));
-    memset(rtext_tab, 0, sizeof(rtext_tab));
-    memset(btext, 0, sizeof(btext));
-    memset(abb, 0, sizeof(abb));
-    memset(cond, 0, sizeof(cond));
-    memset(default_, 0, sizeof(default_));
-    memset(iobj, 0, sizeof(iobj));
-    memset(key, 0, sizeof(key));
-    memset(ltext, 0, sizeof(ltext));
-    memset(stext, 0, sizeof(stext));
-    memset(ktab, 0, sizeof(ktab));
-    memset(travel, 0, sizeof(travel));
-    memset(lline, 0, sizeof(lline));
-    memset(atab, 0, sizeof(atab));
+    while (!(bits & OBJ_BIT(obj)))
+        ++obj;
+    return obj;
+}
+
+/* ------------------------------------------------------------------------- */
+/* World loading and session setup                                           */
+/* ------------------------------------------------------------------------- */
+
+/* Decode every line of LLINE once into w->text as type_20a5 printed it,
+   words 3..lline[i][2], each line ending in a newline and each message
+   (a chain of lines linked through lline[i][1]) in one more. */
+static void text_build(struct adv_world *w, uint_least64_t lline[][23])
+{
+    size_t pos = 0;
+    int i, n;
+
+    for (i = 1; i <= 1000; ++i) {
+        if (lline[i][2] == 0)
+            continue;
+        n = lline[i][2] >= 3 ? (int)lline[i][2] - 2 : 0;
+        if (pos + 5 * (size_t)n + 2 + ADV_A5_SLACK > ADV_TEXT_SIZE) {
+            fprintf(stderr, "L1100: TOO MUCH TEXT\n");
+            exit(EXIT_FAILURE);
+        }
+        w->text_off[i] = (uint16_t)pos;
+        adv_a5_unpack(lline[i] + 3, n, w->text + pos);
+        pos += 5 * (size_t)n;
+        w->text[pos++] = '\n';
+        if (lline[i][1] == 0)
+            w->text[pos++] = '\n';
+    }
+    memset(w->text + pos, 0, ADV_TEXT_SIZE - pos);
+    w->text_size = (int)pos;
+
+    /* a message runs from its first line to the blank line ending its
+       chain, which always goes on to the next line read */
+    for (i = 1000; i >= 1; --i) {
+        if (lline[i][2] == 0)
+            continue;
+        n = lline[i][2] >= 3 ? (int)lline[i][2] - 2 : 0;
+        w->text_len[i] = (uint16_t)(5 * n + 1);
+        if (lline[i][1] != 0)
+            w->text_len[i] = (uint16_t)(w->text_len[i] + w->text_len[i + 1]);
+        else
+            ++w->text_len[i];
+    }
+}
+
+/* Read the advdat TEXT into W (sections 1002..1100 in cca.cpp), then
+   set up the per-object and per-location tables that never change. */
+void adv_world_load(struct adv_world *w, const char *text)
+{
+    const char *cur = text;
+    int i, ikind, jkind, k, kk, l, lkind;
+    int tk[26];
+    uint_least64_t (*lline)[23];    /* the text as read, until decoded */
+
+    memset(w, 0, sizeof(*w));
+    memset(tk, 0, sizeof(tk));
+    lline = calloc(1001, sizeof(*lline));
+    if (!lline) {
+        fprintf(stderr, "adv_world_load(): out of memory\n");
+        exit(EXIT_FAILURE);
+    }
 
     /* --------------------------------------------------------------------- */
     /* READ THE PARAMETERS (sections 1002..1100 in cca.cpp)                  */
@@ -1289,7 +1958,7 @@ static void adventure(void)
 L1002:
     {
         char line[64];
-        if (!advdat_read_line(line, sizeof(line))) {
+        if (!advdat_read_line(&cur, line, sizeof(line))) {
             fprintf(stderr, "L1002: read ikind failed\n");
             exit(EXIT_FAILURE);
         }
@@ -1313,7 +1982,7 @@ L1002:
     }
 
 L1004:
-    rdtext(&jkind, lline[i]);
+    rdtext(&cur, &jkind, lline[i]);
     if (jkind == -1)
         goto L1002;
     for (k = 1; k <= 20; ++k) {
@@ -1333,15 +2002,15 @@ L1007:
         goto L1011;
     if (ikind == 1)
         goto L1008;
-    if (stext[jkind] != 0)
+    if (w->stext[jkind] != 0)
         goto L1009;
-    stext[jkind] = i;
+    w->stext[jkind] = i;
     goto L1010;
 
 L1008:
-    if (ltext[jkind] != 0)
+    if (w->ltext[jkind] != 0)
         goto L1009;
-    ltext[jkind] = i;
+    w->ltext[jkind] = i;
     goto L1010;
 
 L1009:
@@ -1351,49 +2020,50 @@ L1010:
     ++i;
     if (i != 1000)
         goto L1004;
-    pause_game("TOO MANY LINES");
+    fprintf(stderr, "L1010: TOO MANY LINES\n");
+    exit(EXIT_FAILURE);
 
 L1011:
     if (jkind < 200)
         goto L1012;
-    if (btext[jkind - 100] != 0)
+    if (w->btext[jkind - 100] != 0)
         goto L1009;
-    btext[jkind - 100] = i;
-    btext[jkind - 200] = i;
+    w->btext[jkind - 100] = i;
+    w->btext[jkind - 200] = i;
     goto L1010;
 
 L1012:
-    if (btext[jkind] != 0)
+    if (w->btext[jkind] != 0)
         goto L1009;
-    btext[jkind] = i;
+    w->btext[jkind] = i;
     goto L1010;
 
 L1023:
-    if (rtext_tab[jkind] != 0)
+    if (w->rtext_tab[jkind] != 0)
         goto L1009;
-    rtext_tab[jkind] = i;
+    w->rtext_tab[jkind] = i;
     goto L1010;
 
 L1013:
     i = 1;
 
 L1014:
-    rdmap(&jkind, &lkind, tk);
+    rdmap(&cur, &jkind, &lkind, tk);
     if (jkind == -1)
         goto L1002;
-    if (key[jkind] != 0)
+    if (w->key[jkind] != 0)
         goto L1016;
-    key[jkind] = i;
+    w->key[jkind] = i;
     goto L1017;
 
 L1016:
-    travel[i - 1] = -travel[i - 1];
+    w->travel[i - 1] = -w->travel[i - 1];
 
 L1017:
     for (l = 1; l <= 10; ++l) {
         if (tk[l] == 0)
             goto L1019;
-        travel[i] = lkind * 1024 + tk[l];
+        w->travel[i] = lkind * 1024 + tk[l];
         ++i;
         if (i == 1000) {
             fprintf(stderr, "L1017: STOP\n");
@@ -1402,168 +2072,558 @@ L1017:
     }
 
 L1019:
-    travel[i - 1] = -travel[i - 1];
+    w->travel[i - 1] = -w->travel[i - 1];
     goto L1014;
 
 L1020:
     {
         int iu;
         for (iu = 1; iu <= 1000; ++iu) {
-            rdkey(&ktab[iu], &atab[iu]);
-            if (ktab[iu] == -1)
+            rdkey(&cur, &w->ktab[iu], &w->atab[iu]);
+            if (w->ktab[iu] == -1)
                 goto L1002;
         }
     }
-    pause_game("TOO MANY WORDS");
+    fprintf(stderr, "L1020: TOO MANY WORDS\n");
+    exit(EXIT_FAILURE);
 
 L1100:
-    for (i = 1; i <= 100; ++i) {
-        iplace[i] = iplt[i];
-        ifixed[i] = ifixt[i];
-    }
+    for (i = 1; i <= 100; ++i)
+        w->ifixed[i] = ifixt[i];
 
     for (i = 1; i <= 10; ++i)
-        cond[i] = 1;
-    cond[16] = 2;
-    cond[20] = 2;
-    cond[21] = 2;
-    cond[22] = 2;
-    cond[23] = 2;
-    cond[24] = 2;
-    cond[25] = 2;
-    cond[26] = 2;
-    cond[31] = 2;
-    cond[32] = 2;
-    cond[79] = 2;
-
-    for (i = 1; i <= 100; ++i) {
-        ktem = iplace[i];
-        if (ktem == 0)
-            continue;
-        if (iobj[ktem] != 0)
-            goto L1104;
-        iobj[ktem] = i;
-        continue;
-
-L1104:
-        ktem = iobj[ktem];
-
-L1105:
-        if (ichain[ktem] != 0)
-            goto L1106;
-        ichain[ktem] = i;
-        continue;
-
-L1106:
-        ktem = ichain[ktem];
-        goto L1105;
+        w->cond[i] = 1;
+    w->cond[16] = 2;
+    w->cond[20] = 2;
+    w->cond[21] = 2;
+    w->cond[22] = 2;
+    w->cond[23] = 2;
+    w->cond[24] = 2;
+    w->cond[25] = 2;
+    w->cond[26] = 2;
+    w->cond[31] = 2;
+    w->cond[32] = 2;
+    w->cond[79] = 2;
+
+    for (i = 1; i <= 1000 && w->ktab[i] != -1; ++i) {
+        if (w->ktab[i] / 1000 == 1 && w->ktab[i] % 1000 >= ADV_OBJECTS) {
+            fprintf(stderr, "L1100: TOO MANY OBJECTS\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
-    idwarf = 0;
-    ifirst = 1;
-    iwest = 0;
-    ilong = 1;
-    idetal = 0;
-    pause_game("INIT DONE");
+    text_build(w, lline);
+    free(lline);
+    vocab_build(w);
+    motion_build(w);
+    game_start(&w->start);
+}
+
+/* Start a new game in S that plays in world W. */
+void adv_session_init(struct adv_session *s, const struct adv_world *w)
+{
+    memset(s, 0, sizeof(*s));
+    s->w = w;
+    s->g = w->start;
+}
+
+void adv_session_reset(struct adv_session *s)
+{
+    s->g = s->w->start;
+    s->prompt = ADV_PROMPT_NONE;
+    s->next = 0;
+    s->yes_y = 0;
+    s->yes_z = 0;
+}
+
+#ifdef ADVENT_PRECOMPILED
+#include "advdat_world.h"   /* generated by mkworld */
+#endif
+
+const struct adv_world *adv_world_default(void)
+{
+#ifdef ADVENT_PRECOMPILED
+    return &advdat_world;
+#else
+    static struct adv_world world;
+    static int loaded;
+    if (!loaded) {
+        adv_world_load(&world, advdat_77_03_31);
+        loaded = 1;
+    }
+    return &world;
+#endif
+}
+
+/* ------------------------------------------------------------------------- */
+/* World images                                                              */
+/* ------------------------------------------------------------------------- */
+
+/* A world image is this header followed, at offset header_size, by the
+   bytes of a struct adv_world. The struct holds no pointers, so the image
+   can be mapped at any address and used in place. It is only valid for
+   the same struct layout, which is what version, world_size and the byte
+   order tag check. */
+struct image_header {
+    char magic[8];              /* "ADVWORLD" */
+    uint32_t version;           /* ADV_IMAGE_VERSION */
+    uint32_t header_size;
+    uint64_t world_size;        /* sizeof(struct adv_world) */
+    uint64_t checksum;          /* image_checksum() of the world bytes */
+    uint32_t byte_order;        /* 0x01020304 in the writer's byte order */
+    uint32_t reserved;
+};
+
+#define IMAGE_HEADER_SIZE 64    /* keeps the world 64-byte aligned */
+
+/* FNV-1a over 64-bit words. SIZE is a multiple of 8 for struct adv_world. */
+static uint64_t image_checksum(const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = 0xCBF29CE484222325ULL;
+    size_t i;
+
+    for (i = 0; i + 8 <= size; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        h = (h ^ v) * 0x100000001B3ULL;
+    }
+    for (; i < size; ++i)
+        h = (h ^ p[i]) * 0x100000001B3ULL;
+    return h;
+}
+
+int adv_world_save_image(const struct adv_world *w, const char *path)
+{
+    struct image_header hdr;
+    char pad[IMAGE_HEADER_SIZE];
+    FILE *f;
+    int ok;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "ADVWORLD", 8);
+    hdr.version = ADV_IMAGE_VERSION;
+    hdr.header_size = IMAGE_HEADER_SIZE;
+    hdr.world_size = sizeof(*w);
+    hdr.checksum = image_checksum(w, sizeof(*w));
+    hdr.byte_order = 0x01020304;
+    memset(pad, 0, sizeof(pad));
+    memcpy(pad, &hdr, sizeof(hdr));
+
+    f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    ok = fwrite(pad, sizeof(pad), 1, f) == 1
+        && fwrite(w, sizeof(*w), 1, f) == 1;
+    if (fclose(f) != 0)
+        ok = 0;
+    if (!ok) {
+        fprintf(stderr, "%s: write failed\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/* Check that the SIZE bytes at IMAGE hold a world we can use as is. */
+static int image_valid(const char *path, const unsigned char *image, size_t size)
+{
+    struct image_header hdr;
+    const char *why = NULL;
+
+    if (size < IMAGE_HEADER_SIZE) {
+        why = "too short";
+    } else {
+        memcpy(&hdr, image, sizeof(hdr));
+        if (memcmp(hdr.magic, "ADVWORLD", 8) != 0)
+            why = "not a world image";
+        else if (hdr.byte_order != 0x01020304)
+            why = "wrong byte order";
+        else if (hdr.version != ADV_IMAGE_VERSION)
+            why = "unsupported version";
+        else if (hdr.header_size != IMAGE_HEADER_SIZE
+                 || hdr.world_size != sizeof(struct adv_world)
+                 || size != IMAGE_HEADER_SIZE + sizeof(struct adv_world))
+            why = "wrong size for this build";
+        else if (hdr.checksum != image_checksum(image + IMAGE_HEADER_SIZE,
+                                                sizeof(struct adv_world)))
+            why = "checksum mismatch";
+    }
+    if (why) {
+        fprintf(stderr, "%s: %s\n", path, why);
+        return 0;
+    }
+    return 1;
+}
+
+const struct adv_world *adv_world_map_image(const char *path)
+{
+    size_t size = IMAGE_HEADER_SIZE + sizeof(struct adv_world);
+    unsigned char *image;
+#ifdef ADVENT_MMAP
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size != size) {
+        close(fd);
+        fprintf(stderr, "%s: wrong size for this build\n", path);
+        return NULL;
+    }
+    image = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        perror(path);
+        return NULL;
+    }
+    if (!image_valid(path, image, size)) {
+        munmap(image, size);
+        return NULL;
+    }
+#else
+    FILE *f = fopen(path, "rb");
+    size_t got;
+
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    image = malloc(size + 1);
+    got = image ? fread(image, 1, size + 1, f) : 0;
+    fclose(f);
+    if (!image || !image_valid(path, image, got)) {
+        free(image);
+        return NULL;
+    }
+#endif
+    return (const struct adv_world *)(image + IMAGE_HEADER_SIZE);
+}
+
+void adv_world_unmap_image(const struct adv_world *w)
+{
+    unsigned char *image;
+
+    if (!w)
+        return;
+    image = (unsigned char *)w - IMAGE_HEADER_SIZE;
+#ifdef ADVENT_MMAP
+    munmap(image, IMAGE_HEADER_SIZE + sizeof(struct adv_world));
+#else
+    free(image);
+#endif
+}
+
+void adv_session_seed(struct adv_session *s, uint64_t seed)
+{
+    s->ran_seed = seed;
+    s->ran_count = 0;
+}
+
+uint64_t adv_ran_split(uint64_t seed, uint64_t n)
+{
+    return mix64(seed ^ mix64(n + 0x6A09E667F3BCC909ULL));
+}
+
+void adv_session_chance(struct adv_session *s,
+                        int (*chance)(void *ctx, int site, double p), void *ctx)
+{
+    s->chance = chance;
+    s->chance_ctx = ctx;
+}
+
+void adv_chance_path_start(struct adv_chance_path *c)
+{
+    c->bits = 0;
+    c->n = c->len = 0;
+    c->p = 1;
+}
+
+int adv_chance_path_take(void *ctx, int site, double p)
+{
+    struct adv_chance_path *c = (struct adv_chance_path *)ctx;
+    int happens = 0;
+
+    (void)site;
+    if (c->len < c->n)
+        happens = (int)(c->bits >> c->len) & 1;
+    if (c->len < ADV_CHANCES)
+        ++c->len;
+    c->p *= happens ? p : 1 - p;
+    return happens;
+}
+
+int adv_chance_path_next(struct adv_chance_path *c)
+{
+    int i;
+
+    for (i = c->len - 1; i >= 0; --i) {
+        if (!((c->bits >> i) & 1)) {
+            c->bits = (c->bits & ((1u << i) - 1)) | 1u << i;
+            c->n = i + 1;
+            c->len = 0;
+            c->p = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t adv_mix64(uint64_t z)
+{
+    return mix64(z);
+}
+
+void adv_session_headless(struct adv_session *s, uint16_t *events, size_t size)
+{
+    s->events = events;
+    s->evsize = size;
+    s->evlen = 0;
+}
+
+void adv_session_free(struct adv_session *s)
+{
+    free(s->out);
+    s->out = NULL;
+    s->outcap = 0;
+    s->outlen = 0;
+}
+
+void adv_session_fork(struct adv_session *dst, const struct adv_session *src)
+{
+    char *out = dst->out;
+    size_t outcap = dst->outcap;
+    uint16_t *events = dst->events;
+    size_t evsize = dst->evsize;
+
+    *dst = *src;
+    dst->out = out;
+    dst->outcap = outcap;
+    dst->outlen = 0;
+    if (out)
+        out[0] = '\0';
+    dst->events = events;
+    dst->evsize = evsize;
+    dst->evlen = 0;
+}
+
+uint64_t adv_session_hash(const struct adv_session *s)
+{
+    return s->unhashed ? game_hash(&s->g) : s->g.hash;
+}
+
+uint64_t adv_session_key(const struct adv_session *s)
+{
+    return adv_session_hash(s)
+        ^ mix64((uint64_t)s->prompt << 32 ^ (uint64_t)s->next << 16 ^ (uint64_t)s->yes_y);
+}
+
+int adv_session_over(const struct adv_session *s)
+{
+    size_t i;
+
+    if (s->prompt == ADV_PROMPT_OVER)
+        return 1;
+    for (i = 0; i < s->evlen; ++i) {
+        int e = s->events[i];
+        if (ADV_EV_KIND(e) == ADV_EV_PAUSE
+            && (ADV_EV_ARG(e) == ADV_PAUSE_GAME_OVER
+                || ADV_EV_ARG(e) == ADV_PAUSE_GAMES_OVER
+                || ADV_EV_ARG(e) == ADV_PAUSE_GAME_IS_OVER))
+            return 1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Core adventure routine (heavily based on Crowther::adventure in cca.cpp). */
+/* ------------------------------------------------------------------------- */
+
+/* Where adv_step() carries on once a PAUSE or yes/no prompt is answered.
+   Each is the statement following the prompt in Crowther::adventure. */
+enum {
+    NEXT_INSTRUCTIONS,      /* after INIT DONE */
+    NEXT_START,             /* after the instructions question */
+    NEXT_L2,                /* after GAME OVER at L2 */
+    NEXT_L71,
+    NEXT_L1100,
+    NEXT_L2011,
+    NEXT_L2026,
+    NEXT_L2028,
+    NEXT_L2033,
+    NEXT_L2037
+};
+
+/* Run the game from its current prompt to the next; adv_step() without
+   the output setup. */
+static enum adv_prompt adv_run(struct adv_session *s, const char *input)
+{
+    const struct adv_world *w = s->w;
+    int attack, dtot, id, iid, il, ilk, kk, kq, ll, stick, temp;
+    int shown[ADV_OBJECTS], nshown, ishown;
+    int i;
+
+    /* item index constants (matching cca.cpp) */
+    const int keys      = 1;
+    const int lamp      = 2;
+    const int grate     = 3;
+    const int rod       = 5;
+    const int bird      = 7;
+    const int nugget    = 10;
+    const int snake     = 11;
+    const int food      = 19;
+    const int water     = 20;
+    const int axe       = 21;
+
+    switch (s->prompt) {
+    case ADV_PROMPT_NONE:
+        goto L1100;
+    case ADV_PROMPT_PAUSE:
+        if (pause_answer(s, input) <= 0)
+            return s->prompt;
+        break;
+    case ADV_PROMPT_YES:
+        yes_answer(s, input);
+        break;
+    case ADV_PROMPT_COMMAND:
+        goto L2020_input;
+    case ADV_PROMPT_OVER:
+        return s->prompt;
+    }
+
+    switch (s->next) {
+    case NEXT_INSTRUCTIONS: goto resume_instructions;
+    case NEXT_START:        goto resume_start;
+    case NEXT_L2:           goto resume_l2;
+    case NEXT_L71:          goto L71;
+    case NEXT_L1100:        goto L1100;
+    case NEXT_L2011:        goto L2011;
+    case NEXT_L2026:        goto L2026;
+    case NEXT_L2028:        goto L2028;
+    case NEXT_L2033:        goto L2033;
+    case NEXT_L2037:        goto L2037;
+    default:
+        break;
+    }
+    fprintf(stderr, "adv_step(): bad resume point %d\n", s->next);
+    exit(EXIT_FAILURE);
+
+L1100:
+    game_restart(s);
+    pause_game(s, ADV_PAUSE_INIT_DONE, NEXT_INSTRUCTIONS);
+    return s->prompt;
 
     /* --------------------------------------------------------------------- */
     /* Main game loop (labels 1.. etc.), ported from Crowther::adventure.    */
     /* --------------------------------------------------------------------- */
 
-    yes_sub(65, 1, 0, &yea);
-    l = 1;
-    loc = 1;
+resume_instructions:
+    yes_sub(s, 65, 1, 0, NEXT_START);
+    return s->prompt;
+
+resume_start:
+    s->g.l = 1;
+    game_set(s, GF_LOC, 0, 1);
 
 L2:
     /* trace_location was test-only in C++; omitted here */
 
-    if (l == 26)
-        pause_game("GAME OVER");
+    if (s->g.l == 26) {
+        pause_game(s, ADV_PAUSE_GAME_OVER, NEXT_L2);
+        return s->prompt;
+    }
 
+resume_l2:
     for (i = 1; i <= 3; ++i) {
-        if (odloc[i] != l || dseen[i] == 0)
+        if (s->g.odloc[i] != s->g.l || s->g.dseen[i] == 0)
             continue;
-        l = loc;
-        speak(2);
+        s->g.l = s->g.loc;
+        speak(s, 2);
         goto L74;
     }
 L74:
-    loc = l;
+    game_set(s, GF_LOC, 0, s->g.l);
 
-    if (idwarf != 0)
+    if (s->g.idwarf != 0)
         goto L60;
-    if (loc == 15)
-        idwarf = 1;
+    if (s->g.loc == 15)
+        game_set(s, GF_IDWARF, 0, 1);
     goto L71;
 
 L60:
-    if (idwarf != 1)
+    if (s->g.idwarf != 1)
         goto L63;
-    if (io_ran(60) > 0.05)
+    if (!io_chance(s, 60, 0.05))
         goto L71;
-    idwarf = 2;
+    game_set(s, GF_IDWARF, 0, 2);
     for (i = 1; i <= 3; ++i) {
-        dloc[i] = 0;
-        odloc[i] = 0;
-        dseen[i] = 0;
-    }
-    speak(3);
-    ichain[axe] = iobj[loc];
-    iobj[loc] = axe;
-    iplace[axe] = loc;
+        game_set(s, GF_DLOC, i, 0);
+        game_set(s, GF_ODLOC, i, 0);
+        game_set(s, GF_DSEEN, i, 0);
+    }
+    speak(s, 3);
+    obj_move(s, axe, s->g.loc);
     goto L71;
 
 L63:
-    ++idwarf;
+    if (s->g.idwarf < IDWARF_MAX)
+        game_set(s, GF_IDWARF, 0, s->g.idwarf + 1);
     attack = 0;
     dtot = 0;
     stick = 0;
     for (i = 1; i <= 3; ++i) {
-        if (2 * i + idwarf < 8)
+        if (2 * i + s->g.idwarf < 8)
             continue;
-        if (2 * i + idwarf > 23 && dseen[i] == 0)
+        if (2 * i + s->g.idwarf > 23 && s->g.dseen[i] == 0)
             continue;
-        odloc[i] = dloc[i];
-        if (dseen[i] != 0 && loc > 14)
+        game_set(s, GF_ODLOC, i, s->g.dloc[i]);
+        if (s->g.dseen[i] != 0 && s->g.loc > 14)
             goto L65;
-        dloc[i] = dtrav[i * 2 + idwarf - 8];
-        dseen[i] = 0;
-        if (dloc[i] != loc && odloc[i] != loc)
+        game_set(s, GF_DLOC, i, dtrav[i * 2 + s->g.idwarf - 8]);
+        game_set(s, GF_DSEEN, i, 0);
+        if (s->g.dloc[i] != s->g.loc && s->g.odloc[i] != s->g.loc)
             continue;
 L65:
-        dseen[i] = 1;
-        dloc[i] = loc;
+        game_set(s, GF_DSEEN, i, 1);
+        game_set(s, GF_DLOC, i, s->g.loc);
         ++dtot;
-        if (odloc[i] != dloc[i])
+        if (s->g.odloc[i] != s->g.dloc[i])
             continue;
         ++attack;
-        if (io_ran(65) < 0.1)
+        if (io_chance(s, 65, 0.1))
             ++stick;
     }
     if (dtot == 0)
         goto L71;
     if (dtot == 1)
         goto L75;
-    io_type_str("THERE ARE ");
-    io_type_int(dtot);
-    io_type_str(" THREATENING LITTLE DWARVES IN THE ROOM WITH YOU.\n");
+    io_event(s, ADV_EV_DWARVES, dtot);
+    io_type_str(s, "THERE ARE ");
+    io_type_int(s, dtot);
+    io_type_str(s, " THREATENING LITTLE DWARVES IN THE ROOM WITH YOU.\n");
     goto L77;
 
 L75:
-    speak(4);
+    speak(s, 4);
 L77:
     if (attack == 0)
         goto L71;
     if (attack == 1)
         goto L79;
-    io_type_str(" ");
-    io_type_int(attack);
-    io_type_str(" OF THEM THROW KNIVES AT YOU!\n");
+    io_event(s, ADV_EV_KNIVES, attack);
+    io_type_str(s, " ");
+    io_type_int(s, attack);
+    io_type_str(s, " OF THEM THROW KNIVES AT YOU!\n");
     goto L81;
 
 L79:
-    speak(5);
-    speak(52 + stick);
+    speak(s, 5);
+    speak(s, 52 + stick);
     if (stick + 1 == 1)
         goto L71;
     if (stick + 1 == 2)
@@ -1574,107 +2634,94 @@ L81:
         goto L69;
     if (stick == 1)
         goto L82;
-    io_type_str(" ");
-    io_type_int(stick);
-    io_type_str(" OF THEM GET YOU.\n");
+    io_event(s, ADV_EV_HITS, stick);
+    io_type_str(s, " ");
+    io_type_int(s, stick);
+    io_type_str(s, " OF THEM GET YOU.\n");
     goto L83;
 
 L82:
-    speak(6);
+    speak(s, 6);
 
 L83:
-    pause_game("GAMES OVER");
-    goto L71;
+    pause_game(s, ADV_PAUSE_GAMES_OVER, NEXT_L71);
+    return s->prompt;
 
 L69:
-    speak(7);
+    speak(s, 7);
 
 L71:
-    kk = stext[l];
-    if (abb[l] == 0 || kk == 0)
-        kk = ltext[l];
+    kk = w->stext[s->g.l];
+    if (s->g.abb[s->g.l] == 0 || kk == 0)
+        kk = w->ltext[s->g.l];
     if (kk == 0)
         goto L7;
+    if (s->events) {
+        io_event(s, kk == w->ltext[s->g.l] ? ADV_EV_ROOM : ADV_EV_BRIEF, s->g.l);
+        goto L7;
+    }
 
-L4:
-    type_20a5(lline[kk], 3, lline[kk][2]);
-    ++kk;
-    if (lline[kk - 1][1] != 0)
-        goto L4;
-    io_type_str("\n");
+    type_text(s, kk);
 
 L7:
-    if (cond[l] == 2)
+    if (w->cond[s->g.l] == 2)
         goto L8;
-    if (loc == 33 && io_ran(7) < 0.25)
-        speak(8);
-    j = l;
+    if (s->g.loc == 33 && io_chance(s, 7, 0.25))
+        speak(s, 8);
+    s->g.j = s->g.l;
     goto L2000;
 
 L8:
-    kk = key[loc];
-    if (kk == 0)
+    if (w->key[s->g.loc] == 0)
         goto L19;
-    if (k == 57)
+    if (s->g.k == 57)
         goto L32;
-    if (k == 67)
+    if (s->g.k == 67)
         goto L40;
-    if (k == 8)
+    if (s->g.k == 8)
         goto L12;
-    lold = l;
-
-L9:
-    ll = travel[kk];
-    if (ll < 0)
-        ll = -ll;
-    if (1 == (ll % 1024))
-        goto L10;
-    if (k == (ll % 1024))
-        goto L10;
-    if (travel[kk] < 0)
+    game_set(s, GF_LOLD, 0, s->g.l);
+    ll = adv_world_exit(w, s->g.loc, s->g.k);
+    if (ll == 0)
         goto L11;
-    ++kk;
-    goto L9;
-
-L12:
-    temp = lold;
-    lold = l;
-    l = temp;
+    s->g.l = ll;
     goto L21;
 
-L10:
-    l = ll / 1024;
+L12:
+    temp = s->g.lold;
+    game_set(s, GF_LOLD, 0, s->g.l);
+    s->g.l = temp;
     goto L21;
 
 L11:
-    jspk = 12;
-    if (k >= 43 && k <= 46)
-        jspk = 9;
-    if (k == 29 || k == 30)
-        jspk = 9;
-    if (k == 7 || k == 8 || k == 36 || k == 37 || k == 68)
-        jspk = 10;
-    if (k == 11 || k == 19)
-        jspk = 11;
-    if (jverb == 1)
-        jspk = 59;
-    if (k == 48)
-        jspk = 42;
-    if (k == 17)
-        jspk = 80;
-    speak(jspk);
+    s->g.jspk = 12;
+    if (s->g.k >= 43 && s->g.k <= 46)
+        s->g.jspk = 9;
+    if (s->g.k == 29 || s->g.k == 30)
+        s->g.jspk = 9;
+    if (s->g.k == 7 || s->g.k == 8 || s->g.k == 36 || s->g.k == 37 || s->g.k == 68)
+        s->g.jspk = 10;
+    if (s->g.k == 11 || s->g.k == 19)
+        s->g.jspk = 11;
+    if (s->g.jverb == 1)
+        s->g.jspk = 59;
+    if (s->g.k == 48)
+        s->g.jspk = 42;
+    if (s->g.k == 17)
+        s->g.jspk = 80;
+    speak(s, s->g.jspk);
     goto L2;
 
 L19:
-    speak(13);
-    l = loc;
-    if (ifirst == 0)
-        speak(14);
+    speak(s, 13);
+    s->g.l = s->g.loc;
+    if (s->g.ifirst == 0)
+        speak(s, 14);
 
 L21:
-    if (l < 300)
+    if (s->g.l < 300)
         goto L2;
-    il = l - 300 + 1;
+    il = s->g.l - 300 + 1;
     switch (il) {
     case  1: goto L22;
     case  2: goto L23;
@@ -1697,232 +2744,243 @@ L21:
     goto L2;
 
 L22:
-    l = 6;
-    if (io_ran(22) > 0.5)
-        l = 5;
+    s->g.l = 6;
+    if (!io_chance(s, 22, 0.5))
+        s->g.l = 5;
     goto L2;
 
 L23:
-    l = 23;
-    if (iplace[grate] != 0)
-        l = 9;
+    s->g.l = 23;
+    if (s->g.iplace[grate] != 0)
+        s->g.l = 9;
     goto L2;
 
 L24:
-    l = 9;
-    if (iplace[grate] != 0)
-        l = 8;
+    s->g.l = 9;
+    if (s->g.iplace[grate] != 0)
+        s->g.l = 8;
     goto L2;
 
 L25:
-    l = 20;
-    if (iplace[nugget] != -1)
-        l = 15;
+    s->g.l = 20;
+    if (s->g.iplace[nugget] != -1)
+        s->g.l = 15;
     goto L2;
 
 L26:
-    l = 22;
-    if (iplace[nugget] != -1)
-        l = 14;
+    s->g.l = 22;
+    if (s->g.iplace[nugget] != -1)
+        s->g.l = 14;
     goto L2;
 
 L27:
-    l = 27;
-    if (prop[12] == 0)
-        l = 31;
+    s->g.l = 27;
+    if (s->g.prop[12] == 0)
+        s->g.l = 31;
     goto L2;
 
 L28:
-    l = 28;
-    if (prop[snake] == 0)
-        l = 32;
+    s->g.l = 28;
+    if (s->g.prop[snake] == 0)
+        s->g.l = 32;
     goto L2;
 
 L29:
-    l = 29;
-    if (prop[snake] == 0)
-        l = 32;
+    s->g.l = 29;
+    if (s->g.prop[snake] == 0)
+        s->g.l = 32;
     goto L2;
 
 L30:
-    l = 30;
-    if (prop[snake] == 0)
-        l = 32;
+    s->g.l = 30;
+    if (s->g.prop[snake] == 0)
+        s->g.l = 32;
     goto L2;
 
 L31:
-    pause_game("GAME IS OVER");
-    goto L1100;
+    pause_game(s, ADV_PAUSE_GAME_IS_OVER, NEXT_L1100);
+    return s->prompt;
 
 L32:
-    if (idetal < 3)
-        speak(15);
-    ++idetal;
-    l = loc;
-    abb[l] = 0;
+    if (s->g.idetal < 3)
+        speak(s, 15);
+    ++s->g.idetal;
+    s->g.l = s->g.loc;
+    s->g.abb[s->g.l] = 0;
     goto L2;
 
 L33:
-    l = 8;
-    if (prop[grate] == 0)
-        l = 9;
+    s->g.l = 8;
+    if (s->g.prop[grate] == 0)
+        s->g.l = 9;
     goto L2;
 
 L34:
-    if (io_ran(34) > 0.2)
+    if (!io_chance(s, 34, 0.2))
         goto L35;
-    l = 68;
+    s->g.l = 68;
     goto L2;
 
 L35:
-    l = 65;
+    s->g.l = 65;
 
 L38:
-    speak(56);
+    speak(s, 56);
     goto L2;
 
 L36:
-    if (io_ran(361) > 0.2)
+    if (!io_chance(s, 361, 0.2))
         goto L35;
-    l = 39;
-    if (io_ran(362) > 0.5)
-        l = 70;
+    s->g.l = 39;
+    if (!io_chance(s, 362, 0.5))
+        s->g.l = 70;
     goto L2;
 
 L37:
-    l = 66;
-    if (io_ran(371) > 0.4)
+    s->g.l = 66;
+    if (!io_chance(s, 371, 0.4))
         goto L38;
-    l = 71;
-    if (io_ran(372) > 0.25)
-        l = 72;
+    s->g.l = 71;
+    if (!io_chance(s, 372, 0.25))
+        s->g.l = 72;
     goto L2;
 
 L39:
-    l = 66;
-    if (io_ran(39) > 0.2)
+    s->g.l = 66;
+    if (!io_chance(s, 39, 0.2))
         goto L38;
-    l = 77;
+    s->g.l = 77;
     goto L2;
 
 L40:
-    if (loc < 8)
-        speak(57);
-    if (loc >= 8)
-        speak(58);
-    l = loc;
+    if (s->g.loc < 8)
+        speak(s, 57);
+    if (s->g.loc >= 8)
+        speak(s, 58);
+    s->g.l = s->g.loc;
     goto L2;
 
 L2000:
-    ltrubl = 0;
-    loc = j;
-    abb[j] = (abb[j] + 1) % 5;
-    idark = 0;
-    if (cond[j] % 2 == 1)
+    game_set(s, GF_LTRUBL, 0, 0);
+    game_set(s, GF_LOC, 0, s->g.j);
+    s->g.abb[s->g.j] = (unsigned char)((s->g.abb[s->g.j] + 1) % 5);
+    game_set(s, GF_IDARK, 0, 0);
+    if (w->cond[s->g.j] % 2 == 1)
         goto L2003;
-    if (iplace[2] != j && iplace[2] != -1)
+    if (s->g.iplace[2] != s->g.j && s->g.iplace[2] != -1)
         goto L2001;
-    if (prop[2] == 1)
+    if (s->g.prop[2] == 1)
         goto L2003;
 
 L2001:
-    speak(16);
-    idark = 1;
+    speak(s, 16);
+    game_set(s, GF_IDARK, 0, 1);
 
 L2003:
-    i = iobj[j];
+    nshown = obj_list(&s->g, s->g.j, shown);
+    ishown = 0;
 
 L2004:
-    if (i == 0)
+    if (ishown == nshown)
         goto L2011;
-    if ((i == 6 || i == 9) && iplace[10] == -1)
+    i = shown[ishown++];
+    if ((i == 6 || i == 9) && s->g.iplace[10] == -1)
         goto L2008;
     ilk = i;
-    if (prop[i] != 0)
+    if (s->g.prop[i] != 0)
         ilk = i + 100;
-    kk = btext[ilk];
+    kk = w->btext[ilk];
     if (kk == 0)
         goto L2008;
+    if (s->events) {
+        io_event(s, ADV_EV_OBJECT, ilk);
+        goto L2008;
+    }
 
-L2005:
-    type_20a5(lline[kk], 3, lline[kk][2]);
-    ++kk;
-    if (lline[kk - 1][1] != 0)
-        goto L2005;
-    io_type_str("\n");
+    type_text(s, kk);
 
 L2008:
-    i = ichain[i];
     goto L2004;
 
 L2012:
-    a = wd2;
-    b = A5_SPACE;
-    twowds = 0;
+    s->g.a = s->g.wd2;
+    s->g.b = A5_SPACE;
+    s->g.twowds = 0;
     goto L2021;
 
 L2009:
-    k = 54;
+    s->g.k = 54;
 
 L2010:
-    jspk = k;
+    s->g.jspk = s->g.k;
 
 L5200:
-    speak(jspk);
+    speak(s, s->g.jspk);
 
 L2011:
-    jverb = 0;
-    jobj = 0;
-    twowds = 0;
+    game_set(s, GF_JVERB, 0, 0);
+    game_set(s, GF_JOBJ, 0, 0);
+    s->g.twowds = 0;
 
 L2020:
-    getin(&twowds, &a, &wd2, &b);
-    k = 70;
-    if (a == as_a5("ENTER") && (wd2 == as_a5("STREA") || wd2 == as_a5("WATER")))
+    s->prompt = ADV_PROMPT_COMMAND;
+    return s->prompt;
+
+L2020_input:
+    if (!s->unhashed)
+        s->g.hash ^= game_word(s->g.wd2);
+    if (s->command) {
+        s->g.twowds = s->command->twowds;
+        s->g.a = s->command->a;
+        s->g.wd2 = s->command->wd2;
+        s->g.b = s->command->b;
+        s->command = NULL;
+    } else {
+        getin(input, &s->g.twowds, &s->g.a, &s->g.wd2, &s->g.b);
+    }
+    if (!s->unhashed)
+        s->g.hash ^= game_word(s->g.wd2);
+    s->g.k = 70;
+    if (s->g.a == A5_ENTER && (s->g.wd2 == A5_STREA || s->g.wd2 == A5_WATER))
         goto L2010;
-    if (a == as_a5("ENTER") && twowds)
+    if (s->g.a == A5_ENTER && s->g.twowds)
         goto L2012;
 
 L2021:
-    if (a != as_a5("WEST"))
+    if (s->g.a != A5_WEST)
         goto L2023;
-    ++iwest;
-    if (iwest != 10)
+    ++s->g.iwest;
+    if (s->g.iwest != 10)
         goto L2023;
-    speak(17);
+    speak(s, 17);
 
 L2023:
-    for (i = 1; i <= 1000; ++i) {
-        if (ktab[i] == -1)
-            goto L3000;
-        if (atab[i] == a)
-            goto L2025;
-    }
-    pause_game("ERROR 6");
+    i = vocab_find(w, s->g.a);
+    if (i == 0)
+        goto L3000;
 
-L2025:
-    k = ktab[i] % 1000;
-    kq = ktab[i] / 1000 + 1;
+    s->g.k = w->ktab[i] % 1000;
+    kq = w->ktab[i] / 1000 + 1;
     switch (kq) {
     case 1: goto L5014;
     case 2: goto L5000;
     case 3: goto L2026;
     case 4: goto L2010;
     default:
-        pause_game("NO NO");
-        break;
+        pause_game(s, ADV_PAUSE_NO_NO, NEXT_L2026);
+        return s->prompt;
     }
 
 L2026:
-    jverb = k;
-    jspk = jspkt[jverb];
-    if (twowds != 0)
+    game_set(s, GF_JVERB, 0, s->g.k);
+    s->g.jspk = jspkt[s->g.jverb];
+    if (s->g.twowds != 0)
         goto L2028;
-    if (jobj == 0)
+    if (s->g.jobj == 0)
         goto L2036;
 
 L2027:
-    switch (jverb) {
+    switch (s->g.jverb) {
     case  1: goto L9000;
     case  2: goto L5066;
     case  3: goto L3000;
@@ -1940,57 +2998,58 @@ L2027:
     case 15: goto L5504;
     case 16: goto L5505;
     default:
-        pause_game("ERROR 5");
-        break;
+        pause_game(s, ADV_PAUSE_ERROR_5, NEXT_L2028);
+        return s->prompt;
     }
 
 L2028:
-    a = wd2;
-    b = A5_SPACE;
-    twowds = 0;
+    s->g.a = s->g.wd2;
+    s->g.b = A5_SPACE;
+    s->g.twowds = 0;
     goto L2023;
 
 L3000:
-    jspk = 60;
-    if (io_ran(30001) > 0.8)
-        jspk = 61;
-    if (io_ran(30002) > 0.8)
-        jspk = 13;
-    speak(jspk);
-    ++ltrubl;
-    if (ltrubl != 3)
+    s->g.jspk = 60;
+    if (!io_chance(s, 30001, 0.8))
+        s->g.jspk = 61;
+    if (!io_chance(s, 30002, 0.8))
+        s->g.jspk = 13;
+    speak(s, s->g.jspk);
+    game_set(s, GF_LTRUBL, 0, s->g.ltrubl + 1);
+    if (s->g.ltrubl != 3)
         goto L2020;
-    if (j != 13 || iplace[7] != 13 || iplace[5] != -1)
+    if (s->g.j != 13 || s->g.iplace[7] != 13 || s->g.iplace[5] != -1)
         goto L2032;
-    yes_sub(18, 19, 54, &yea);
-    goto L2033;
+    yes_sub(s, 18, 19, 54, NEXT_L2033);
+    return s->prompt;
 
 L2032:
-    if (j != 19 || prop[11] != 0 || iplace[7] == -1)
+    if (s->g.j != 19 || s->g.prop[11] != 0 || s->g.iplace[7] == -1)
         goto L2034;
-    yes_sub(20, 21, 54, &yea);
-    goto L2033;
+    yes_sub(s, 20, 21, 54, NEXT_L2033);
+    return s->prompt;
 
 L2034:
-    if (j != 8 || prop[grate] != 0)
+    if (s->g.j != 8 || s->g.prop[grate] != 0)
         goto L2035;
-    yes_sub(62, 63, 54, &yea);
+    yes_sub(s, 62, 63, 54, NEXT_L2033);
+    return s->prompt;
 
 L2033:
-    if (yea == 0)
+    if (s->g.yea == 0)
         goto L2011;
     goto L2020;
 
 L2035:
-    if (iplace[5] != j && iplace[5] != -1)
+    if (s->g.iplace[5] != s->g.j && s->g.iplace[5] != -1)
         goto L2020;
-    if (jobj != 5)
+    if (s->g.jobj != 5)
         goto L2020;
-    speak(22);
+    speak(s, 22);
     goto L2020;
 
 L2036:
-    switch (jverb) {
+    switch (s->g.jverb) {
     case  1: goto L2037;
     case  2: goto L5062;
     case  3: goto L5062;
@@ -2008,349 +3067,966 @@ L2036:
     case 15: goto L5062;
     case 16: goto L5062;
     default:
-        pause_game("OOPS");
-        break;
+        pause_game(s, ADV_PAUSE_OOPS, NEXT_L2037);
+        return s->prompt;
     }
 
 L2037:
-    if (iobj[j] == 0 || ichain[iobj[j]] != 0)
+    if (s->g.here[s->g.j] == 0 || (s->g.here[s->g.j] & (s->g.here[s->g.j] - 1)) != 0)
         goto L5062;
     for (i = 1; i <= 3; ++i) {
-        if (dseen[i] != 0)
+        if (s->g.dseen[i] != 0)
             goto L5062;
     }
-    jobj = iobj[j];
+    game_set(s, GF_JOBJ, 0, obj_lowest(s->g.here[s->g.j]));
     goto L2027;
 
 L5062:
-    if (b != A5_SPACE)
+    io_event(s, ADV_EV_WHAT, s->g.jverb);
+    if (s->g.b != A5_SPACE)
         goto L5333;
     {
         char sa[6];
-        a5_to_string(a, sa);
-        io_type_str("  ");
-        io_type_str(sa);
-        io_type_str(" WHAT?\n");
+        a5_to_string(s->g.a, sa);
+        io_type_str(s, "  ");
+        io_type_str(s, sa);
+        io_type_str(s, " WHAT?\n");
     }
     goto L2020;
 
 L5333:
     {
         char sa[6], sb[6];
-        a5_to_string(a, sa);
-        a5_to_string(b, sb);
-        io_type_str(" ");
-        io_type_str(sa);
-        io_type_str(sb);
-        io_type_str(" WHAT?\n");
+        a5_to_string(s->g.a, sa);
+        a5_to_string(s->g.b, sb);
+        io_type_str(s, " ");
+        io_type_str(s, sa);
+        io_type_str(s, sb);
+        io_type_str(s, " WHAT?\n");
     }
     goto L2020;
 
 L5014:
-    if (idark == 0)
+    if (s->g.idark == 0)
         goto L8;
-    if (io_ran(5014) > 0.25)
+    if (!io_chance(s, 5014, 0.25))
         goto L8;
-    speak(23);
-    pause_game("GAME IS OVER");
-    goto L2011;
+    speak(s, 23);
+    pause_game(s, ADV_PAUSE_GAME_IS_OVER, NEXT_L2011);
+    return s->prompt;
 
 L5000:
-    jobj = k;
-    if (twowds != 0)
+    game_set(s, GF_JOBJ, 0, s->g.k);
+    if (s->g.twowds != 0)
         goto L2028;
-    if (j == iplace[k] || iplace[k] == -1)
+    if (s->g.j == s->g.iplace[s->g.k] || s->g.iplace[s->g.k] == -1)
         goto L5004;
-    if (k != grate)
+    if (s->g.k != grate)
         goto L502;
-    if (j == 1 || j == 4 || j == 7)
+    if (s->g.j == 1 || s->g.j == 4 || s->g.j == 7)
         goto L5098;
-    if (j > 9 && j < 15)
+    if (s->g.j > 9 && s->g.j < 15)
         goto L5097;
 
 L502:
-    if (b != A5_SPACE)
+    io_event(s, ADV_EV_NOT_HERE, s->g.jobj);
+    if (s->g.b != A5_SPACE)
         goto L5316;
     {
         char sa[6];
-        a5_to_string(a, sa);
-        io_type_str(" I SEE NO ");
-        io_type_str(sa);
-        io_type_str(" HERE.\n");
+        a5_to_string(s->g.a, sa);
+        io_type_str(s, " I SEE NO ");
+        io_type_str(s, sa);
+        io_type_str(s, " HERE.\n");
     }
     goto L2011;
 
 L5316:
     {
         char sa[6], sb[6];
-        a5_to_string(a, sa);
-        a5_to_string(b, sb);
-        io_type_str(" I SEE NO ");
-        io_type_str(sa);
-        io_type_str(sb);
-        io_type_str(" HERE.\n");
+        a5_to_string(s->g.a, sa);
+        a5_to_string(s->g.b, sb);
+        io_type_str(s, " I SEE NO ");
+        io_type_str(s, sa);
+        io_type_str(s, sb);
+        io_type_str(s, " HERE.\n");
     }
     goto L2011;
 
 L5098:
-    k = 49;
+    s->g.k = 49;
     goto L5014;
 
 L5097:
-    k = 50;
+    s->g.k = 50;
     goto L5014;
 
 L5004:
-    jobj = k;
-    if (jverb != 0)
+    game_set(s, GF_JOBJ, 0, s->g.k);
+    if (s->g.jverb != 0)
         goto L2027;
-    if (b != A5_SPACE)
+    io_event(s, ADV_EV_WHAT_WITH, s->g.jobj);
+    if (s->g.b != A5_SPACE)
         goto L5314;
     {
         char sa[6];
-        a5_to_string(a, sa);
-        io_type_str(" WHAT DO YOU WANT TO DO WITH THE ");
-        io_type_str(sa);
-        io_type_str("?\n");
+        a5_to_string(s->g.a, sa);
+        io_type_str(s, " WHAT DO YOU WANT TO DO WITH THE ");
+        io_type_str(s, sa);
+        io_type_str(s, "?\n");
     }
     goto L2020;
 
 L5314:
     {
         char sa[6], sb[6];
-        a5_to_string(a, sa);
-        a5_to_string(b, sb);
-        io_type_str(" WHAT DO YOU WANT TO DO WITH THE ");
-        io_type_str(sa);
-        io_type_str(sb);
-        io_type_str("?\n");
+        a5_to_string(s->g.a, sa);
+        a5_to_string(s->g.b, sb);
+        io_type_str(s, " WHAT DO YOU WANT TO DO WITH THE ");
+        io_type_str(s, sa);
+        io_type_str(s, sb);
+        io_type_str(s, "?\n");
     }
     goto L2020;
 
 L9000:
-    if (jobj == 18)
+    if (s->g.jobj == 18)
         goto L2009;
-    if (iplace[jobj] != j)
+    if (s->g.iplace[s->g.jobj] != s->g.j)
         goto L5200;
-    if (ifixed[jobj] == 0)
+    if (w->ifixed[s->g.jobj] == 0)
         goto L9002;
-    speak(25);
+    speak(s, 25);
     goto L2011;
 
 L9002:
-    if (jobj != bird)
+    if (s->g.jobj != bird)
         goto L9004;
-    if (iplace[rod] != -1)
+    if (s->g.iplace[rod] != -1)
         goto L9003;
-    speak(26);
+    speak(s, 26);
     goto L2011;
 
 L9003:
-    if (iplace[4] == -1 || iplace[4] == j)
+    if (s->g.iplace[4] == -1 || s->g.iplace[4] == s->g.j)
         goto L9004;
-    speak(27);
+    speak(s, 27);
     goto L2011;
 
 L9004:
-    iplace[jobj] = -1;
-
-L9005:
-    if (iobj[j] != jobj)
-        goto L9006;
-    iobj[j] = ichain[jobj];
-    goto L2009;
-
-L9006:
-    itemp = iobj[j];
-
-L9007:
-    if (ichain[itemp] == jobj)
-        goto L9008;
-    itemp = ichain[itemp];
-    goto L9007;
-
-L9008:
-    ichain[itemp] = ichain[jobj];
+    obj_move(s, s->g.jobj, -1);
     goto L2009;
 
 L9403:
-    if (j == 8 || j == 9)
+    if (s->g.j == 8 || s->g.j == 9)
         goto L5105;
-    speak(28);
+    speak(s, 28);
     goto L2011;
 
 L5105:
-    jobj = grate;
+    game_set(s, GF_JOBJ, 0, grate);
     goto L2027;
 
 L5066:
-    if (jobj == 18)
+    if (s->g.jobj == 18)
         goto L2009;
-    if (iplace[jobj] != -1)
+    if (s->g.iplace[s->g.jobj] != -1)
         goto L5200;
-    if (jobj != bird || j != 19 || prop[11] == 1)
+    if (s->g.jobj != bird || s->g.j != 19 || s->g.prop[11] == 1)
         goto L9401;
-    speak(30);
-    prop[11] = 1;
+    speak(s, 30);
+    game_set(s, GF_PROP, 11, 1);
 
 L5160:
-    ichain[jobj] = iobj[j];
-    iobj[j] = jobj;
-    iplace[jobj] = j;
+    obj_move(s, s->g.jobj, s->g.j);
     goto L2011;
 
 L9401:
-    speak(54);
+    speak(s, 54);
     goto L5160;
 
 L5031:
-    if (iplace[keys] != -1 && iplace[keys] != j)
+    if (s->g.iplace[keys] != -1 && s->g.iplace[keys] != s->g.j)
         goto L5200;
-    if (jobj != 4)
+    if (s->g.jobj != 4)
         goto L5102;
-    speak(32);
+    speak(s, 32);
     goto L2011;
 
 L5102:
-    if (jobj != keys)
+    if (s->g.jobj != keys)
         goto L5104;
-    speak(55);
+    speak(s, 55);
     goto L2011;
 
 L5104:
-    if (jobj == grate)
+    if (s->g.jobj == grate)
         goto L5107;
-    speak(33);
+    speak(s, 33);
     goto L2011;
 
 L5107:
-    if (jverb == 4)
+    if (s->g.jverb == 4)
         goto L5033;
-    if (prop[grate] != 0)
+    if (s->g.prop[grate] != 0)
         goto L5034;
-    speak(34);
+    speak(s, 34);
     goto L2011;
 
 L5034:
-    speak(35);
-    prop[grate] = 0;
-    prop[8] = 0;
+    speak(s, 35);
+    game_set(s, GF_PROP, grate, 0);
+    game_set(s, GF_PROP, 8, 0);
     goto L2011;
 
 L5033:
-    if (prop[grate] == 0)
+    if (s->g.prop[grate] == 0)
         goto L5109;
-    speak(36);
+    speak(s, 36);
     goto L2011;
 
 L5109:
-    speak(37);
-    prop[grate] = 1;
-    prop[8] = 1;
+    speak(s, 37);
+    game_set(s, GF_PROP, grate, 1);
+    game_set(s, GF_PROP, 8, 1);
     goto L2011;
 
 L9404:
-    if (iplace[2] != j && iplace[2] != -1)
+    if (s->g.iplace[2] != s->g.j && s->g.iplace[2] != -1)
         goto L5200;
-    prop[2] = 1;
-    idark = 0;
-    speak(39);
+    game_set(s, GF_PROP, 2, 1);
+    game_set(s, GF_IDARK, 0, 0);
+    speak(s, 39);
     goto L2011;
 
 L9406:
-    if (iplace[2] != j && iplace[2] != -1)
+    if (s->g.iplace[2] != s->g.j && s->g.iplace[2] != -1)
         goto L5200;
-    prop[2] = 0;
-    speak(40);
+    game_set(s, GF_PROP, 2, 0);
+    speak(s, 40);
     goto L2011;
 
 L5081:
-    if (jobj != 12)
+    if (s->g.jobj != 12)
         goto L5200;
-    prop[12] = 1;
+    game_set(s, GF_PROP, 12, 1);
     goto L2003;
 
 L5300:
     for (id = 1; id <= 3; ++id) {
         iid = id;
-        if (dseen[id] != 0)
+        if (s->g.dseen[id] != 0)
             goto L5307;
     }
-    if (jobj == 0)
+    if (s->g.jobj == 0)
         goto L5062;
-    if (jobj == snake)
+    if (s->g.jobj == snake)
         goto L5200;
-    if (jobj == bird)
+    if (s->g.jobj == bird)
         goto L5302;
-    speak(44);
+    speak(s, 44);
     goto L2011;
 
 L5302:
-    speak(45);
-    iplace[jobj] = 300;
-    goto L9005;
+    speak(s, 45);
+    obj_move(s, s->g.jobj, 300);
+    goto L2009;
 
 L5307:
-    if (io_ran(5307) > 0.4)
+    if (!io_chance(s, 5307, 0.4))
         goto L5309;
-    dseen[iid] = 0;
-    odloc[iid] = 0;
-    dloc[iid] = 0;
-    speak(47);
+    game_set(s, GF_DSEEN, iid, 0);
+    game_set(s, GF_ODLOC, iid, 0);
+    game_set(s, GF_DLOC, iid, 0);
+    speak(s, 47);
     goto L5311;
 
 L5309:
-    speak(48);
+    speak(s, 48);
 
 L5311:
-    k = 21;
+    s->g.k = 21;
     goto L5014;
 
 L5502:
-    if ((iplace[food] != j && iplace[food] != -1) || prop[food] != 0 || jobj != food)
+    if ((s->g.iplace[food] != s->g.j && s->g.iplace[food] != -1) || s->g.prop[food] != 0 || s->g.jobj != food)
         goto L5200;
-    prop[food] = 1;
-    jspk = 72;
+    game_set(s, GF_PROP, food, 1);
+    s->g.jspk = 72;
     goto L5200;
 
 L5504:
-    if ((iplace[water] != j && iplace[water] != -1) || prop[water] != 0 || jobj != water)
+    if ((s->g.iplace[water] != s->g.j && s->g.iplace[water] != -1) || s->g.prop[water] != 0 || s->g.jobj != water)
         goto L5200;
-    prop[water] = 1;
-    jspk = 74;
+    game_set(s, GF_PROP, water, 1);
+    s->g.jspk = 74;
     goto L5200;
 
 L5505:
-    if (jobj != lamp)
-        jspk = 76;
+    if (s->g.jobj != lamp)
+        s->g.jspk = 76;
     goto L5200;
 
 L5506:
-    if (jobj != water)
-        jspk = 78;
-    prop[water] = 1;
+    if (s->g.jobj != water)
+        s->g.jspk = 78;
+    game_set(s, GF_PROP, water, 1);
     goto L5200;
 }
 
+enum adv_prompt adv_step(struct adv_session *s, const char *input)
+{
+    enum adv_prompt prompt;
+
+    s->outlen = 0;
+    if (s->out)
+        s->out[0] = '\0';
+    s->evlen = 0;
+
+    prompt = adv_run(s, input ? input : "");
+
+    /* a headless game answers the prompts that only hold it up itself */
+    while (s->events) {
+        if (prompt == ADV_PROMPT_PAUSE)
+            prompt = adv_run(s, "G");
+        else if (prompt == ADV_PROMPT_YES && s->next == NEXT_START)
+            prompt = adv_run(s, "NO");
+        else
+            break;
+    }
+    return prompt;
+}
+
+const char *adv_output(const struct adv_session *s, size_t *len)
+{
+    if (len)
+        *len = s->outlen;
+    return s->out ? s->out : "";
+}
+
+/* ------------------------------------------------------------------------- */
+/* Saved sessions                                                            */
+/* ------------------------------------------------------------------------- */
+
+/* A saved session is a 16-byte header, "ADVS", the version, the size and
+   the save_checksum() of the rest, followed by the fields in the order
+   adv_session_save() writes them. Only dwarves 1..3 exist and only their
+   rooms are saved; here[], held and the hash are rebuilt, and of the
+   stamps only their order counts, so each object's rank is saved. */
+#define SAVE_HEADER_SIZE 16
+
+/* Little-endian fields, written out byte by byte so compilers turn them
+   into single loads and stores on little-endian machines. */
+static unsigned char *save_put16(unsigned char *p, unsigned v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    return p + 2;
+}
+
+static unsigned char *save_put32(unsigned char *p, uint32_t v)
+{
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+    return p + 4;
+}
+
+static unsigned char *save_put64(unsigned char *p, uint64_t v)
+{
+    return save_put32(save_put32(p, (uint32_t)v), (uint32_t)(v >> 32));
+}
+
+static unsigned save_get16(const unsigned char *p)
+{
+    return (unsigned)p[0] | (unsigned)p[1] << 8;
+}
+
+static uint32_t save_get32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8
+        | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t save_get64(const unsigned char *p)
+{
+    return (uint64_t)save_get32(p) | (uint64_t)save_get32(p + 4) << 32;
+}
+
+/* Signed fields of 16 and 32 bits. */
+static int save_get16s(const unsigned char *p)
+{
+    return (int)((save_get16(p) ^ 0x8000u) - 0x8000u);
+}
+
+static int save_get32s(const unsigned char *p)
+{
+    return (int)(int64_t)(((uint64_t)save_get32(p) ^ 0x80000000u) - 0x80000000u);
+}
+
+/* FNV-1a over the little-endian 64-bit words of the SIZE bytes at P, a
+   multiple of 8, so it is the same on every machine. */
+static uint64_t save_checksum(const unsigned char *p, size_t size)
+{
+    uint64_t h = 0xCBF29CE484222325ULL;
+    size_t i;
+
+    for (i = 0; i < size; i += 8)
+        h = (h ^ save_get64(p + i)) * 0x100000001B3ULL;
+    return h;
+}
+
+void adv_session_save(const struct adv_session *s, unsigned char buf[ADV_SAVE_SIZE])
+{
+    const struct adv_game *g = &s->g;
+    unsigned char *p = buf + SAVE_HEADER_SIZE;
+    int i;
+
+    p = save_put32(p, (uint32_t)g->idark);
+    p = save_put32(p, (uint32_t)g->idetal);
+    p = save_put32(p, (uint32_t)g->idwarf);
+    p = save_put32(p, (uint32_t)g->ifirst);
+    p = save_put32(p, (uint32_t)g->ilong);
+    p = save_put32(p, (uint32_t)g->iwest);
+    p = save_put32(p, (uint32_t)g->j);
+    p = save_put32(p, (uint32_t)g->jobj);
+    p = save_put32(p, (uint32_t)g->jspk);
+    p = save_put32(p, (uint32_t)g->jverb);
+    p = save_put32(p, (uint32_t)g->k);
+    p = save_put32(p, (uint32_t)g->l);
+    p = save_put32(p, (uint32_t)g->loc);
+    p = save_put32(p, (uint32_t)g->lold);
+    p = save_put32(p, (uint32_t)g->ltrubl);
+    p = save_put32(p, (uint32_t)g->yea);
+    p = save_put64(p, g->a);
+    p = save_put64(p, g->b);
+    p = save_put64(p, g->twowds);
+    p = save_put64(p, g->wd2);
+    for (i = 1; i <= 3; ++i) {
+        p = save_put16(p, (unsigned)g->dloc[i] & 0xFFFF);
+        p = save_put16(p, (unsigned)g->odloc[i] & 0xFFFF);
+        *p++ = (unsigned char)g->dseen[i];
+    }
+    for (i = 1; i < ADV_OBJECTS; ++i)
+        p = save_put16(p, (unsigned)g->iplace[i] & 0xFFFF);
+    for (i = 1; i < ADV_OBJECTS; ++i)
+        *p++ = (unsigned char)g->prop[i];
+    for (i = 0; i < 300; i += 2)
+        *p++ = (unsigned char)(g->abb[i] | g->abb[i + 1] << 4);
+    *p++ = g->abb[300];
+
+    /* the place of each object in its room's list, counted from the end */
+    for (i = 1; i < ADV_OBJECTS; ++i) {
+        int place = g->iplace[i], rank = 0;
+        if (place > 0 && place < 300) {
+            uint32_t bits = g->here[place] & ~OBJ_BIT(i);
+            for (; bits; bits &= bits - 1)
+                rank += g->stamp[obj_lowest(bits)] < g->stamp[i];
+        }
+        *p++ = (unsigned char)rank;
+    }
+
+    p = save_put64(p, s->ran_seed);
+    p = save_put64(p, s->ran_count);
+    *p++ = (unsigned char)s->prompt;
+    *p++ = (unsigned char)s->next;
+    p = save_put16(p, (unsigned)s->yes_y & 0xFFFF);
+    save_put16(p, (unsigned)s->yes_z & 0xFFFF);
+
+    memcpy(buf, "ADVS", 4);
+    save_put16(buf + 4, ADV_SAVE_VERSION);
+    save_put16(buf + 6, ADV_SAVE_SIZE);
+    save_put64(buf + 8, save_checksum(buf + SAVE_HEADER_SIZE,
+                                      ADV_SAVE_SIZE - SAVE_HEADER_SIZE));
+}
+
+/* Where a dwarf can be: a room, 0 before it comes or once it is dead,
+   or the 9999 that dtrav[0] sends it to. */
+static int dwarf_place(int place)
+{
+    return (place >= 0 && place <= 300) || place == 9999;
+}
+
+int adv_session_restore(struct adv_session *s, const unsigned char buf[ADV_SAVE_SIZE])
+{
+    struct adv_game g;
+    const unsigned char *p = buf + SAVE_HEADER_SIZE;
+    const char *why = NULL;
+    int i, prompt, next;
+
+    if (memcmp(buf, "ADVS", 4) != 0)
+        why = "not a saved session";
+    else if (save_get16(buf + 4) != ADV_SAVE_VERSION)
+        why = "unsupported version";
+    else if (save_get16(buf + 6) != ADV_SAVE_SIZE)
+        why = "wrong size";
+    else if (save_get64(buf + 8) != save_checksum(p, ADV_SAVE_SIZE - SAVE_HEADER_SIZE))
+        why = "checksum mismatch";
+    if (why) {
+        fprintf(stderr, "adv_session_restore: %s\n", why);
+        return -1;
+    }
+
+    memset(&g, 0, sizeof(g));
+    g.idark = save_get32s(p);
+    g.idetal = save_get32s(p + 4);
+    g.idwarf = save_get32s(p + 8);
+    g.ifirst = save_get32s(p + 12);
+    g.ilong = save_get32s(p + 16);
+    g.iwest = save_get32s(p + 20);
+    g.j = save_get32s(p + 24);
+    g.jobj = save_get32s(p + 28);
+    g.jspk = save_get32s(p + 32);
+    g.jverb = save_get32s(p + 36);
+    g.k = save_get32s(p + 40);
+    g.l = save_get32s(p + 44);
+    g.loc = save_get32s(p + 48);
+    g.lold = save_get32s(p + 52);
+    g.ltrubl = save_get32s(p + 56);
+    g.yea = save_get32s(p + 60);
+    p += 64;
+    g.a = save_get64(p);
+    g.b = save_get64(p + 8);
+    g.twowds = save_get64(p + 16);
+    g.wd2 = save_get64(p + 24);
+    p += 32;
+    for (i = 1; i <= 3; ++i, p += 5) {
+        g.dloc[i] = save_get16s(p);
+        g.odloc[i] = save_get16s(p + 2);
+        g.dseen[i] = p[4];
+        if (!dwarf_place(g.dloc[i]) || !dwarf_place(g.odloc[i]))
+            why = "dwarf out of the cave";
+        else if (g.dseen[i] > 1)
+            why = "bad flag";
+    }
+    for (i = 1; i < ADV_OBJECTS; ++i, p += 2) {
+        int place = save_get16s(p);
+        if (place < -1 || place > 300)
+            why = "object out of the cave";
+        else
+            obj_place(&g, i, place);
+    }
+    for (i = 1; i < ADV_OBJECTS; ++i) {
+        g.prop[i] = *p++;
+        if (g.prop[i] > 1)
+            why = "object out of the cave";
+    }
+    for (i = 0; i < 300; i += 2, ++p) {
+        g.abb[i] = *p & 15;
+        g.abb[i + 1] = *p >> 4;
+    }
+    g.abb[300] = *p++;
+    for (i = 1; i < ADV_OBJECTS; ++i)
+        g.stamp[i] = *p++ + 1;
+    g.nstamp = ADV_OBJECTS;
+    g.hash = game_hash(&g);
+    if (g.loc < 0 || g.loc > 300 || g.lold < 0 || g.lold > 300
+        || g.j < 0 || g.j > 300 || g.jverb < 0 || g.jverb > 100)
+        why = "location out of the cave";
+    if (g.jobj < 0 || g.jobj >= ADV_OBJECTS)
+        why = "object out of the cave";
+    if (g.idwarf < 0 || g.idwarf > IDWARF_MAX)
+        why = "dwarf out of the cave";
+    if (g.k < 0 || g.k > 100 || g.jspk < 0 || g.jspk > 100)
+        why = "unknown word";
+    if (g.idark < 0 || g.idark > 1)
+        why = "bad flag";
+
+    prompt = p[16];
+    next = p[17];
+    /* L31 pauses in a special room, 301..315, before starting over */
+    if (g.l < 0 || g.l > (next == NEXT_L1100 ? 315 : 300))
+        why = "location out of the cave";
+    if (prompt > ADV_PROMPT_OVER || next > NEXT_L2037
+        || save_get16(p + 18) > 100 || save_get16(p + 20) > 100)
+        why = "unknown prompt";
+    if (why) {
+        fprintf(stderr, "adv_session_restore: %s\n", why);
+        return -1;
+    }
+
+    s->g = g;
+    s->ran_seed = save_get64(p);
+    s->ran_count = save_get64(p + 8);
+    s->prompt = (enum adv_prompt)prompt;
+    s->next = next;
+    s->yes_y = (int)save_get16(p + 18);
+    s->yes_z = (int)save_get16(p + 20);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Commands and goals for tools                                              */
+/* ------------------------------------------------------------------------- */
+
+/* Write the word at atab[I] to WORD as it would be typed and return its
+   length, or 0 if it cannot be typed: the parser would split it at a
+   space, or an earlier entry spelled the same way hides it. */
+static int command_word(const struct adv_world *w, int i, char word[5 + ADV_A5_SLACK])
+{
+    int n;
+
+    adv_a5_unpack(&w->atab[i], 1, word);
+    for (n = 5; n > 0 && word[n - 1] == ' '; --n)
+        ;
+    word[n] = '\0';
+    if (n == 0 || memchr(word, ' ', (size_t)n) || vocab_find(w, w->atab[i]) != i)
+        return 0;
+    return n;
+}
+
+int adv_world_commands(const struct adv_world *w, char (*cmds)[ADV_COMMAND_SIZE], int max)
+{
+    char words[1001][5 + ADV_A5_SLACK];
+    int first[1001];        /* indices of the first typable word of each meaning */
+    int seen[4000];
+    int nfirst = 0, n = 0;
+    int i, j;
+
+    memset(seen, 0, sizeof(seen));
+    for (i = 1; i < 1001 && w->ktab[i] != -1; ++i) {
+        int k = w->ktab[i];
+        if (k < 0 || k >= 4000 || seen[k] || !command_word(w, i, words[i]))
+            continue;
+        seen[k] = 1;
+        first[nfirst++] = i;
+    }
+
+    for (i = 0; i < nfirst; ++i, ++n)
+        if (n < max)
+            strcpy(cmds[n], words[first[i]]);
+
+    /* each verb (2000..2999) with each object (1000..1999) */
+    for (i = 0; i < nfirst; ++i) {
+        if (w->ktab[first[i]] / 1000 != 2)
+            continue;
+        for (j = 0; j < nfirst; ++j) {
+            if (w->ktab[first[j]] / 1000 != 1)
+                continue;
+            if (n < max)
+                sprintf(cmds[n], "%s %s", words[first[i]], words[first[j]]);
+            ++n;
+        }
+    }
+    return n;
+}
+
+/* The object named by the word or number at *P, which is left after it;
+   0 if there is none. */
+static int goal_object(const struct adv_world *w, const char **p)
+{
+    char word[6];
+    uint_least64_t a5;
+    int i, n;
+
+    if (isdigit((unsigned char)**p))
+        return (int)strtol(*p, (char **)p, 10);
+    for (n = 0; isalpha((unsigned char)(*p)[n]); ++n)
+        if (n < 5)
+            word[n] = (char)toupper((unsigned char)(*p)[n]);
+    word[n < 5 ? n : 5] = '\0';
+    *p += n;
+    a5 = as_a5(word);
+    for (i = 1; i < 1001 && w->ktab[i] != -1; ++i)
+        if (w->atab[i] == a5 && w->ktab[i] / 1000 == 1)
+            return w->ktab[i] % 1000;
+    return 0;
+}
+
+int adv_goal_parse(struct adv_goal *goal, const struct adv_world *w, const char *spec)
+{
+    const char *p = spec;
+
+    goal->n = 0;
+    while (*p) {
+        int what = *p, obj = 0, val = 0;
+        const char *eq = strchr(p, '=');
+        char *end;
+
+        if (goal->n == ADV_GOAL_TERMS || !eq)
+            goto bad;
+        if (eq - p == 4 && strncmp(p, "room", 4) == 0) {
+            val = (int)strtol(eq + 1, &end, 10);
+            p = end;
+        } else if (eq - p == 4 && strncmp(p, "hold", 4) == 0) {
+            p = eq + 1;
+            obj = goal_object(w, &p);
+            val = -1;
+        } else if ((eq - p == 4 && strncmp(p, "prop", 4) == 0)
+                   || (eq - p == 5 && strncmp(p, "place", 5) == 0)) {
+            what = what == 'p' && p[1] == 'r' ? 'p' : 'o';
+            p = eq + 1;
+            obj = goal_object(w, &p);
+            if (*p++ != ':')
+                goto bad;
+            val = (int)strtol(p, &end, 10);
+            p = end;
+        } else {
+            goto bad;
+        }
+        if (obj < 0 || obj >= ADV_OBJECTS || (what != 'r' && obj == 0)
+            || (what == 'r' && (val < 1 || val > 300)))
+            goto bad;
+        goal->term[goal->n].what = what;
+        goal->term[goal->n].obj = obj;
+        goal->term[goal->n].val = val;
+        ++goal->n;
+        if (*p == ',')
+            ++p;
+        else if (*p)
+            goto bad;
+    }
+    return 0;
+
+bad:
+    fprintf(stderr, "bad goal \"%s\": expected room=N, hold=OBJ, prop=OBJ:V or place=OBJ:N\n",
+            spec);
+    return -1;
+}
+
+int adv_goal_met(const struct adv_goal *goal, const struct adv_session *s)
+{
+    int i;
+
+    for (i = 0; i < goal->n; ++i) {
+        int obj = goal->term[i].obj, val = goal->term[i].val;
+        switch (goal->term[i].what) {
+        case 'r':
+            if (s->g.loc != val)
+                return 0;
+            break;
+        case 'p':
+            if (s->g.prop[obj] != val)
+                return 0;
+            break;
+        default:    /* 'h', 'o' */
+            if (s->g.iplace[obj] != val)
+                return 0;
+            break;
+        }
+    }
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Parsed commands and batches of games                                      */
+/* ------------------------------------------------------------------------- */
+
+void adv_command_parse(struct adv_command *c, const char *text)
+{
+    strncpy(c->text, text, sizeof(c->text) - 1);
+    c->text[sizeof(c->text) - 1] = '\0';
+    getin(text, &c->twowds, &c->a, &c->wd2, &c->b);
+}
+
+enum adv_prompt adv_step_command(struct adv_session *s, const struct adv_command *c)
+{
+    enum adv_prompt prompt;
+
+    s->command = c;
+    prompt = adv_step(s, c->text);
+    s->command = NULL;          /* not taken if S was not at a command */
+    return prompt;
+}
+
+/* Start a new game as game I of B, played up to its first command. */
+static void batch_start(struct adv_batch *b, int i)
+{
+    struct adv_session *s = &b->s[i];
+
+    adv_session_reset(s);
+    adv_session_seed(s, adv_ran_split(b->seed, b->started++));
+    adv_step(s, NULL);
+}
+
+/* Sixteen games at a time: a cache line of each array is written whole
+   while the fields of those games are still in cache. */
+void adv_batch_observe(struct adv_batch *b)
+{
+    const struct adv_session *s = b->s;
+    int n = b->n, lo, hi, i, k;
+
+    for (lo = 0; lo < n; lo = hi) {
+        hi = lo + 16 < n ? lo + 16 : n;
+        for (i = lo; i < hi; ++i) {
+            b->loc[i] = s[i].g.loc;
+            b->idwarf[i] = s[i].g.idwarf;
+        }
+        for (k = 0; k < ADV_OBJECTS; ++k)
+            for (i = lo; i < hi; ++i)
+                b->iplace[k * n + i] = s[i].g.iplace[k];
+        for (k = 0; k < ADV_OBJECTS; ++k)
+            for (i = lo; i < hi; ++i)
+                b->prop[k * n + i] = s[i].g.prop[k];
+        for (k = 0; k < 11; ++k)
+            for (i = lo; i < hi; ++i)
+                b->dloc[k * n + i] = s[i].g.dloc[k];
+    }
+}
+
+int adv_batch_init(struct adv_batch *b, const struct adv_world *w, int n, uint64_t seed)
+{
+    int i;
+
+    memset(b, 0, sizeof(*b));
+    b->n = n;
+    b->seed = seed;
+    b->s = malloc((size_t)n * sizeof(*b->s));
+    b->events = malloc((size_t)n * ADV_BATCH_EVENTS * sizeof(*b->events));
+    b->loc = malloc((size_t)n * sizeof(*b->loc));
+    b->idwarf = malloc((size_t)n * sizeof(*b->idwarf));
+    b->iplace = malloc((size_t)n * ADV_OBJECTS * sizeof(*b->iplace));
+    b->prop = malloc((size_t)n * ADV_OBJECTS * sizeof(*b->prop));
+    b->dloc = malloc((size_t)n * 11 * sizeof(*b->dloc));
+    b->done = calloc((size_t)n, 1);
+    if (!b->s || !b->events || !b->loc || !b->idwarf || !b->iplace
+        || !b->prop || !b->dloc || !b->done) {
+        fprintf(stderr, "adv_batch_init(): out of memory\n");
+        adv_batch_free(b);
+        return -1;
+    }
+    for (i = 0; i < n; ++i) {
+        adv_session_init(&b->s[i], w);
+        adv_session_headless(&b->s[i], b->events + (size_t)i * ADV_BATCH_EVENTS,
+                             ADV_BATCH_EVENTS);
+        b->s[i].unhashed = 1;
+        batch_start(b, i);
+    }
+    adv_batch_observe(b);
+    return 0;
+}
+
+void adv_batch_free(struct adv_batch *b)
+{
+    free(b->s);
+    free(b->events);
+    free(b->loc);
+    free(b->idwarf);
+    free(b->iplace);
+    free(b->prop);
+    free(b->dloc);
+    free(b->done);
+    memset(b, 0, sizeof(*b));
+}
+
+void adv_batch_step(struct adv_batch *b, const struct adv_command *cmds, const int *actions)
+{
+    int i;
+
+    for (i = 0; i < b->n; ++i) {
+        adv_step_command(&b->s[i], &cmds[actions[i]]);
+        b->done[i] = (unsigned char)adv_session_over(&b->s[i]);
+        if (b->done[i])
+            batch_start(b, i);
+    }
+    adv_batch_observe(b);
+}
+
 /* ------------------------------------------------------------------------- */
 /* main()                                                                    */
 /* ------------------------------------------------------------------------- */
 
-int main(void)
+#ifndef ADVENT_NO_MAIN
+
+static void io_getline(char *buf, size_t bufsize)
+{
+    if (!fgets(buf, (int)bufsize, stdin)) {
+        /* treat EOF as empty line */
+        buf[0] = '\0';
+        return;
+    }
+    /* strip trailing newline */
+    size_t len = strlen(buf);
+    if (len > 0 && buf[len - 1] == '\n')
+        buf[len - 1] = '\0';
+}
+
+/* Write the LEN bytes at BUF to stdout at once: one write() per turn
+   where there is one. */
+static void io_flush(const char *buf, size_t len)
 {
-    io_type_str(
+#ifdef ADVENT_WRITE
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("write");
+            exit(EXIT_FAILURE);
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+#else
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    static struct adv_session session;
+    const struct adv_world *world = NULL;
+    char line[256];
+    enum adv_prompt prompt;
+    uint64_t seed = (uint64_t)time(NULL);
+    uint16_t events[1024];
+    char evtext[sizeof(events) / sizeof(events[0]) * 12];
+    int headless = 0;
+    size_t e, len;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-world") == 0 && i + 1 < argc) {
+            world = adv_world_map_image(argv[++i]);
+            if (!world)
+                return EXIT_FAILURE;
+        } else if (strcmp(argv[i], "-headless") == 0) {
+            headless = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-seed N] [-world IMAGE] [-headless]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!world)
+        world = adv_world_default();
+
+    fputs(
         "-----------------------------------------------------------------\n"
         "     Will Crowther's original 1976 \"Colossal Cave Adventure\"\n"
         "               A faithful reimplementation in C\n"
         "          by Erik Lins, 2025  (CC0 1.0) Public Domain\n"
         "          (based on Anthony Hay's C++ version, 2024)\n"
         "-----------------------------------------------------------------\n"
-        "To quit hit Ctrl-C\n\n");
+        "To quit hit Ctrl-C\n\n", stdout);
+    fflush(stdout);
 
-    srand((unsigned)time(NULL));
+    adv_session_init(&session, world);
+    adv_session_seed(&session, seed);
+    if (headless)
+        adv_session_headless(&session, events, sizeof(events) / sizeof(events[0]));
 
-    adventure();
-    return 0;
+    prompt = adv_step(&session, NULL);
+    for (;;) {
+        const char *out = adv_output(&session, &len);
+        if (headless) {
+            /* the events as "kind arg" lines */
+            for (e = 0, len = 0; e < session.evlen; ++e)
+                len += (size_t)sprintf(evtext + len, "%u %u\n",
+                                       ADV_EV_KIND(events[e]),
+                                       ADV_EV_ARG(events[e]));
+            out = evtext;
+        }
+        io_flush(out, len);
+        if (prompt == ADV_PROMPT_OVER)
+            return EXIT_FAILURE;
+        io_getline(line, sizeof(line));
+        prompt = adv_step(&session, line);
+    }
 }
 
-
+#endif /* ADVENT_NO_MAIN */
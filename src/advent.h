@@ -0,0 +1,435 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    Public interface to the adventure engine in advent.c.
+
+    A world holds the tables read from advdat and is never written once
+    loaded, so one world can be shared by any number of sessions. A session
+    is one game in progress. The engine never reads input itself: the host
+    calls adv_step() with each line the player types and gets back the text
+    the game printed up to its next prompt. One thread can therefore drive
+    as many games as it likes, from an event loop or a batch scheduler.
+
+    Compile advent.c with -DADVENT_NO_MAIN to use it as a library.
+*/
+
+#ifndef ADVENT_H
+#define ADVENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Arrays are sized according to original FORTRAN/C++ declarations. */
+
+#define ADV_VOCAB_BUCKETS 251   /* vocabulary hash buckets: 1000 words / 4 + 1 */
+#define ADV_MOTIONS 100         /* motion table columns: verbs 0..99 */
+#define ADV_OBJECTS 32          /* objects are numbered 1..31, a bit each */
+#define ADV_TEXT_SIZE 32768     /* text pool: about 15 KB used */
+
+/* The state of play. A new game begins from a copy of the world's
+   snapshot of it; a game started over after the player is killed takes
+   only the objects and the flags L1100 sets from it, as in cca.cpp. */
+struct adv_game {
+    int dloc[11], dseen[11], odloc[11];
+    int iplace[ADV_OBJECTS], prop[ADV_OBJECTS];
+    unsigned char abb[301];
+
+    /* the objects lying in each room and those carried, a bit per object
+       (kept in step with iplace); stamp orders the objects of a room as
+       they are listed, most recently dropped first */
+    uint32_t here[301], held;
+    int stamp[ADV_OBJECTS], nstamp;
+
+    int idark, idetal, idwarf, ifirst, ilong, iwest;
+    int j, jobj, jspk, jverb, k, l, loc, lold, ltrubl, yea;
+    uint_least64_t a, b, twowds, wd2;
+
+    /* Zobrist hash of the state, kept up to date as it changes (see
+       adv_session_hash()) */
+    uint64_t hash;
+};
+
+/* The world: everything read from advdat (plus the tables derived from it
+   that never change during play). Once loaded it is only ever read, so a
+   single copy can be shared by any number of game sessions. */
+struct adv_world {
+    int ifixed[101], rtext_tab[101];
+    int btext[201];
+    int cond[301], default_[301], key[301], ltext[301], stext[301];
+    int ktab[1001], travel[1001];
+    char text[ADV_TEXT_SIZE];            /* every message, decoded */
+    int text_size;                       /* bytes of text used */
+    uint16_t text_off[1001], text_len[1001]; /* message from line i */
+    uint_least64_t atab[1001];           /* keyword table */
+
+    /* minimal perfect hash of atab, built by adv_world_load() */
+    uint64_t vocab_salt;
+    int vocab_n, vocab_buckets;
+    uint16_t vocab_disp[ADV_VOCAB_BUCKETS][2];
+    uint16_t vocab_slot[1000];
+
+    /* key/travel flattened by adv_world_load(): motion[loc][k] is where
+       motion verb K leads from room LOC, 0 if nowhere */
+    uint16_t motion[301][ADV_MOTIONS];
+
+    /* the game as it starts (after L1100 in cca.cpp) */
+    struct adv_game start;
+};
+
+/* What the game is waiting for at the end of an adv_step(). */
+enum adv_prompt {
+    ADV_PROMPT_NONE,        /* game not started yet */
+    ADV_PROMPT_PAUSE,       /* PAUSE: G to resume, X to terminate */
+    ADV_PROMPT_YES,         /* answer to a yes/no question */
+    ADV_PROMPT_COMMAND,     /* a one or two word command */
+    ADV_PROMPT_OVER         /* program terminated; no more input taken */
+};
+
+struct adv_command;
+
+/* One game in progress: all the state adventure() modifies, including the
+   locals of Crowther::adventure that must survive from one command to the
+   next. Small enough to allocate one per player. */
+struct adv_session {
+    const struct adv_world *w;
+    struct adv_game g;
+
+    /* io_ran() stream: the n-th number is a function of (ran_seed, n) */
+    uint64_t ran_seed, ran_count;
+
+    /* decides random events instead of the stream if not NULL (see
+       adv_session_chance()) */
+    int (*chance)(void *ctx, int site, double p);
+    void *chance_ctx;
+
+    /* if set, g.hash is not kept up to date, and adv_session_hash()
+       computes it instead: for the games of a batch (see adv_batch_step()),
+       which step far more often than they are hashed */
+    int unhashed;
+
+    /* where adv_step() stopped and where it carries on once the prompt
+       has been answered */
+    enum adv_prompt prompt;
+    int next;
+    int yes_y, yes_z;
+
+    /* the command adv_step_command() is playing, already parsed, or NULL */
+    const struct adv_command *command;
+
+    /* output arena: the text of the current adv_step(), kept from one
+       step to the next and grown as needed */
+    char *out;
+    size_t outcap, outlen;
+
+    /* headless play: the events of the current adv_step(), or NULL */
+    uint16_t *events;
+    size_t evsize, evlen;
+};
+
+/* What a headless game reports instead of text: each event is a uint16_t
+   of kind << 12 | arg. */
+enum adv_event {
+    ADV_EV_SPEAK = 1,       /* message ARG */
+    ADV_EV_ROOM,            /* long description of room ARG */
+    ADV_EV_BRIEF,           /* short description of room ARG */
+    ADV_EV_OBJECT,          /* object ARG is here (ARG + 100: changed state) */
+    ADV_EV_DWARVES,         /* ARG threatening little dwarves in the room */
+    ADV_EV_KNIVES,          /* ARG of them throw knives */
+    ADV_EV_HITS,            /* ARG of them get you */
+    ADV_EV_WHAT,            /* verb ARG given without an object */
+    ADV_EV_NOT_HERE,        /* object ARG asked for is not here */
+    ADV_EV_WHAT_WITH,       /* object ARG given without a verb */
+    ADV_EV_PAUSE            /* PAUSE ARG (enum adv_pause), answered G */
+};
+
+#define ADV_EV_KIND(e)  ((e) >> 12)
+#define ADV_EV_ARG(e)   ((e) & 07777)
+
+/* Why the game paused. */
+enum adv_pause {
+    ADV_PAUSE_INIT_DONE,
+    ADV_PAUSE_GAME_OVER,    /* reached room 26 */
+    ADV_PAUSE_GAMES_OVER,   /* killed by dwarves */
+    ADV_PAUSE_GAME_IS_OVER, /* killed; the game starts again */
+    ADV_PAUSE_NO_NO,        /* the rest are internal errors */
+    ADV_PAUSE_ERROR_5,
+    ADV_PAUSE_OOPS
+};
+
+/* Initial size of a session's output arena; it doubles when outgrown. */
+#define ADV_OUTPUT_SIZE 8192
+
+/* The advdat.77-03-31 data file, embedded in advent.c. */
+extern const char advdat_77_03_31[];
+
+/* Parse advdat TEXT into W. Exits on malformed data. */
+void adv_world_load(struct adv_world *w, const char *text);
+
+/* The world of the embedded advdat.77-03-31. Built with
+   -DADVENT_PRECOMPILED this is const data generated by mkworld and nothing
+   is parsed at run time; otherwise it is parsed on the first call, which
+   must not race with another. */
+const struct adv_world *adv_world_default(void);
+
+/* Version of the world image format written by adv_world_save_image().
+   Bump it whenever struct adv_world changes. */
+#define ADV_IMAGE_VERSION 7
+
+/* Where motion verb K leads from room LOC in W, as its travel table says:
+   a room, a special case (>= 300, resolved by the engine), or 0 if K goes
+   nowhere from LOC. BACK, LOOK and CAVE are handled by the engine before
+   the table is consulted. One load for the verbs of ADV_MOTIONS. */
+int adv_world_exit(const struct adv_world *w, int loc, int k);
+
+/* Write up to MAX rooms that a motion can take the player to from LOC in
+   W to ROOMS and return how many there are: every destination in LOC's
+   travel entries, with each special case replaced by all the rooms it can
+   lead to. BACK is left out; it goes back along one of these. For tools
+   that need the cave as a graph. */
+int adv_world_adjacent(const struct adv_world *w, int loc, int *rooms, int max);
+
+/* Write W to PATH as a world image: a small header followed by the bytes
+   of the struct, which contains no pointers. Returns 0, or -1 after
+   reporting the error on stderr. */
+int adv_world_save_image(const struct adv_world *w, const char *path);
+
+/* Map the world image at PATH read-only (with mmap() where available, so
+   every process loading it shares one page-cache copy) and return the
+   world inside it, usable as is. Only the header and checksum are
+   checked; nothing is parsed. Returns NULL after reporting the error on
+   stderr. */
+const struct adv_world *adv_world_map_image(const char *path);
+
+/* Release a world returned by adv_world_map_image(). */
+void adv_world_unmap_image(const struct adv_world *w);
+
+/* Start a new game in S that plays in world W. */
+void adv_session_init(struct adv_session *s, const struct adv_world *w);
+
+/* Start S over in a new game, from the first adv_step() on, keeping its
+   random number stream, output arena and headless setting. A copy of
+   w->start; nothing is recomputed. */
+void adv_session_reset(struct adv_session *s);
+
+/* Seed the random number stream of S. Two sessions given the same seed
+   and the same input lines produce identical games. */
+void adv_session_seed(struct adv_session *s, uint64_t seed);
+
+/* Derive the seed for the N-th independent stream from SEED, so a batch
+   of games can be seeded from one number. */
+uint64_t adv_ran_split(uint64_t seed, uint64_t n);
+
+/* Decide the random events of S with CHANCE instead of its random number
+   stream: for each one the engine calls CHANCE(CTX, SITE, P), where SITE
+   is the statement label in cca.cpp (60 for the dwarf appearing, 5014 for
+   the pit...) and P the probability that the event happens, and it
+   happens if CHANCE returns non-zero. For tools that follow every outcome
+   rather than one. NULL goes back to the stream. */
+void adv_session_chance(struct adv_session *s,
+                        int (*chance)(void *ctx, int site, double p), void *ctx);
+
+#define ADV_CHANCES 32          /* random events a path follows in one command */
+
+/* The outcomes of the random events of one command, a bit each in the
+   order they are decided (1: the event happens), and the probability of
+   those taken so far: for tools that try every combination. Given to
+   adv_session_chance() with adv_chance_path_take(), a path follows its
+   first N bits and takes the rest as not happening; adv_chance_path_next()
+   then moves it on to the next combination, so every one is tried exactly
+   once. */
+struct adv_chance_path {
+    uint32_t bits;
+    int n, len;
+    double p;
+};
+
+/* Start C at the first combination: nothing happens. */
+void adv_chance_path_start(struct adv_chance_path *c);
+
+/* The CHANCE of adv_session_chance(), with a struct adv_chance_path as
+   CTX. */
+int adv_chance_path_take(void *ctx, int site, double p);
+
+/* Move C on to the next combination of the events its last command
+   decided; 0 once all are done. */
+int adv_chance_path_next(struct adv_chance_path *c);
+
+/* SplitMix64's output function: every bit of Z mixed into every bit of
+   the result, for tools that hash game states into tables. */
+uint64_t adv_mix64(uint64_t z);
+
+/* Pack the first 20 characters of LINE, upper-cased and padded with
+   spaces, into four A5 words: the words of a player's command. */
+void adv_a5_pack_line(const char *line, uint_least64_t words[4]);
+
+/* Unpack the N A5 words at WORDS into their 5 * N characters at OUT,
+   which must have room for ADV_A5_SLACK bytes more; no NUL is added. */
+void adv_a5_unpack(const uint_least64_t *words, int n, char *out);
+
+#define ADV_A5_SLACK 3
+
+/* "avx2", "sse2" or "scalar": which of the A5 kernels above advent.c was
+   compiled with. */
+const char *adv_a5_kernel(void);
+
+/* Play S headless from now on: for bots and batch runs that have no use
+   for the text. adv_step() then produces no text but records up to SIZE
+   events at EVENTS, their number in s->evlen; pauses are answered G and
+   the question whether to show the instructions NO, so adv_step() only
+   returns at a command or another yes/no question. */
+void adv_session_headless(struct adv_session *s, uint16_t *events, size_t size);
+
+/* Free the output arena of S. S can still be played; the arena is
+   allocated again by the next adv_step() that has output. */
+void adv_session_free(struct adv_session *s);
+
+/* Make DST a copy of the game in SRC as it stands, random number stream
+   included, so both play on identically until given different input: a
+   branch for searching what might happen. DST, initialized with
+   adv_session_init() or forked before, keeps its own output arena and
+   headless setting, so the same sessions can be forked again and again
+   without allocating. A struct copy of a few KB. */
+void adv_session_fork(struct adv_session *dst, const struct adv_session *src);
+
+/* A 64-bit hash of the game in S, for transposition tables and spotting
+   repeated states: where the objects are and their states, where the
+   player and the dwarves are, whether it is dark, the counters that
+   decide what happens next, and the words of the last command that a
+   later one can still pick up. Equal games have equal hashes; compare
+   sessions waiting at the same kind of prompt. Kept up to date by the
+   engine as the game changes, so this is a load, not a computation,
+   unless S is unhashed. */
+uint64_t adv_session_hash(const struct adv_session *s);
+
+/* A key for the state S is in, for tools that search the game: its game
+   (adv_session_hash()) and the prompt it waits at, with where the engine
+   carries on once it is answered. Equal keys are states that play on
+   alike from the same command, whatever the random numbers. */
+uint64_t adv_session_key(const struct adv_session *s);
+
+/* Whether the last adv_step() of the headless session S ended its game:
+   the player was killed (a game-over pause, answered at once) or the
+   game stopped (ADV_PROMPT_OVER). */
+int adv_session_over(const struct adv_session *s);
+
+/* Room for a command written by adv_world_commands(), NUL included. */
+#define ADV_COMMAND_SIZE 12
+
+/* Write up to MAX commands a player can give in W to CMDS and return how
+   many there are: for each distinct meaning in the vocabulary its first
+   word that can be typed, alone, then each verb with each object. For
+   tools that try everything. */
+int adv_world_commands(const struct adv_world *w, char (*cmds)[ADV_COMMAND_SIZE], int max);
+
+#define ADV_GOAL_TERMS 8
+
+/* A state of the game to search for: all of up to ADV_GOAL_TERMS terms. */
+struct adv_goal {
+    int n;
+    struct {
+        int what;           /* 'r'oom, 'h'eld, 'p'rop or 'o'bject place */
+        int obj, val;
+    } term[ADV_GOAL_TERMS];
+};
+
+/* Parse SPEC into GOAL: terms separated by commas, each one of
+       room=N       the player is in room N
+       hold=OBJ     OBJ is carried
+       prop=OBJ:V   OBJ is in state V
+       place=OBJ:N  OBJ is in room N
+   where OBJ is an object number or a word of W naming it (NUGGET,
+   GRATE...). Returns 0, or -1 after reporting the error on stderr. */
+int adv_goal_parse(struct adv_goal *goal, const struct adv_world *w, const char *spec);
+
+/* Whether the game in S has reached GOAL. */
+int adv_goal_met(const struct adv_goal *goal, const struct adv_session *s);
+
+/* Bytes written by adv_session_save(). */
+#define ADV_SAVE_SIZE 424
+
+/* Version of the saved session layout. Bump it whenever the layout or the
+   meaning of a saved field changes. */
+#define ADV_SAVE_VERSION 1
+
+/* Write the game in progress in S to BUF: a fixed layout of little-endian
+   fields with a version and checksum, the same on every machine. It holds
+   the whole of the game, the prompt the game is waiting at and the random
+   number stream, so a game saved at any prompt carries on exactly as it
+   would have. The world, output arena and headless setting are not saved. */
+void adv_session_save(const struct adv_session *s, unsigned char buf[ADV_SAVE_SIZE]);
+
+/* Replace the game in S, which must play in the world the game was saved
+   from, with the one saved at BUF. Returns 0, or -1 after reporting the
+   error on stderr, leaving S unchanged. */
+int adv_session_restore(struct adv_session *s, const unsigned char buf[ADV_SAVE_SIZE]);
+
+/* Run the game from the prompt it is waiting at to the next one.
+
+   INPUT is the line answering the current prompt (without the newline);
+   it is ignored on the first call, which runs the game from the start.
+   Everything the game prints on the way is collected in the session's
+   output arena (see adv_output()), or the events of a headless game in
+   s->events. Returns the prompt now waiting; s->prompt holds the same
+   value. Once ADV_PROMPT_OVER is returned the game is finished. */
+enum adv_prompt adv_step(struct adv_session *s, const char *input);
+
+/* The text printed by the last adv_step(), NUL terminated, with its
+   length in *LEN if LEN is not NULL. Valid until the next adv_step(). */
+const char *adv_output(const struct adv_session *s, size_t *len);
+
+/* A command parsed once, to be played any number of times without
+   parsing its text again. */
+struct adv_command {
+    char text[ADV_COMMAND_SIZE];        /* as typed, for answers to prompts */
+    uint_least64_t twowds, a, wd2, b;   /* as getin() reads it */
+};
+
+/* Parse TEXT into C: the first ADV_COMMAND_SIZE - 1 characters are kept
+   as its text, which is all adv_world_commands() writes. */
+void adv_command_parse(struct adv_command *c, const char *text);
+
+/* adv_step() with the command C, parsed with adv_command_parse(). */
+enum adv_prompt adv_step_command(struct adv_session *s, const struct adv_command *c);
+
+/* Events a game of a batch can record in one step. */
+#define ADV_BATCH_EVENTS 256
+
+/* N headless games for reinforcement learning and the like, with what
+   the agent sees of them exported as structure of arrays, one array per
+   field across all N games, ready to be copied into a tensor. The games
+   are ordinary sessions, s[i], stepped one after another with
+   adv_step_command(): a batch plays them no differently than a loop over
+   sessions would. What it adds is the loop, a new game in place of one
+   that is over (adv_session_over()), and the export. The games are
+   unhashed (see adv_session_hash()): a batch seldom needs a hash. */
+struct adv_batch {
+    int n;
+    struct adv_session *s;      /* the games, s[i] for game i */
+    uint16_t *events;           /* ADV_BATCH_EVENTS for each game */
+    uint64_t seed, started;     /* the K-th game started is seeded
+                                   adv_ran_split(seed, K) */
+
+    /* after the last step, FIELD[i] for game i and FIELD[k * n + i] for
+       element k of an array field */
+    int *loc, *idwarf;
+    int *iplace, *prop;         /* ADV_OBJECTS elements */
+    int *dloc;                  /* 11 elements, as in struct adv_game */
+    unsigned char *done;        /* the game ended; s[i] is a new one */
+};
+
+/* Start N games in B in world W, seeded from SEED. Returns 0, or -1
+   after reporting the error on stderr. */
+int adv_batch_init(struct adv_batch *b, const struct adv_world *w, int n, uint64_t seed);
+
+/* Free what adv_batch_init() allocated. */
+void adv_batch_free(struct adv_batch *b);
+
+/* Play command CMDS[ACTIONS[i]] in game i of B, for every game, and
+   fill in the arrays of B. */
+void adv_batch_step(struct adv_batch *b, const struct adv_command *cmds, const int *actions);
+
+/* Fill in the arrays of B from its games as they are now: for games
+   stepped some other way than adv_batch_step(), through B->s. */
+void adv_batch_observe(struct adv_batch *b);
+
+#endif /* ADVENT_H */
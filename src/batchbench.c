@@ -0,0 +1,206 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    batchbench: steps a second of adv_batch_step() against games stepped
+    one at a time.
+
+    Plays the same B games both ways, each given a random one-word command
+    (mostly motions) every step: one at a time, as an environment wrapping
+    a single session would, with adv_step() on the command's text and the
+    fields the agent sees read from each session; and with
+    adv_batch_step(), which steps the same kind of sessions in a loop of
+    its own but with the commands parsed once, no hash, and the fields
+    exported a block of games at a time. It checks first that both play
+    identical games, then times them.
+
+        cc -std=c99 -O2 -DADVENT_NO_MAIN advent.c batchbench.c -o batchbench
+        ./batchbench [games] [steps]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "advent.h"
+
+#define MAX_COMMANDS 1024
+
+static char commands[MAX_COMMANDS][ADV_COMMAND_SIZE];
+static struct adv_command parsed[MAX_COMMANDS];
+static int nwords;
+
+static double now(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* The actions of step T: a one-word command for each of N games. */
+static void pick_actions(int *actions, int n, int t)
+{
+    int i;
+
+    for (i = 0; i < n; ++i)
+        actions[i] = (int)(adv_ran_split((uint64_t)t, (uint64_t)i) % (uint64_t)nwords);
+}
+
+/* ------------------------------------------------------------------------- */
+/* One game at a time                                                        */
+/* ------------------------------------------------------------------------- */
+
+/* N sessions and the same arrays as a batch, filled in game by game. */
+struct single {
+    struct adv_session *s;
+    uint16_t *events;
+    uint64_t seed, started;
+    int *loc, *idwarf, *iplace, *prop, *dloc;
+    unsigned char *done;
+};
+
+static void single_start(struct single *g, int i)
+{
+    adv_session_reset(&g->s[i]);
+    adv_session_seed(&g->s[i], adv_ran_split(g->seed, g->started++));
+    adv_step(&g->s[i], NULL);
+}
+
+static int single_over(const struct adv_session *s)
+{
+    size_t i;
+
+    if (s->prompt == ADV_PROMPT_OVER)
+        return 1;
+    for (i = 0; i < s->evlen; ++i) {
+        int e = s->events[i];
+        if (ADV_EV_KIND(e) == ADV_EV_PAUSE
+            && (ADV_EV_ARG(e) == ADV_PAUSE_GAME_OVER
+                || ADV_EV_ARG(e) == ADV_PAUSE_GAMES_OVER
+                || ADV_EV_ARG(e) == ADV_PAUSE_GAME_IS_OVER))
+            return 1;
+    }
+    return 0;
+}
+
+static void single_init(struct single *g, const struct adv_world *w, int n, uint64_t seed)
+{
+    int i;
+
+    g->s = malloc((size_t)n * sizeof(*g->s));
+    g->events = malloc((size_t)n * ADV_BATCH_EVENTS * sizeof(*g->events));
+    g->loc = malloc((size_t)n * sizeof(int));
+    g->idwarf = malloc((size_t)n * sizeof(int));
+    g->iplace = malloc((size_t)n * ADV_OBJECTS * sizeof(int));
+    g->prop = malloc((size_t)n * ADV_OBJECTS * sizeof(int));
+    g->dloc = malloc((size_t)n * 11 * sizeof(int));
+    g->done = malloc((size_t)n);
+    if (!g->s || !g->events || !g->loc || !g->idwarf || !g->iplace || !g->prop
+        || !g->dloc || !g->done) {
+        fprintf(stderr, "batchbench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    g->seed = seed;
+    g->started = 0;
+    for (i = 0; i < n; ++i) {
+        adv_session_init(&g->s[i], w);
+        adv_session_headless(&g->s[i], g->events + (size_t)i * ADV_BATCH_EVENTS,
+                             ADV_BATCH_EVENTS);
+        single_start(g, i);
+    }
+}
+
+static void single_step(struct single *g, int n, const int *actions)
+{
+    int i, k;
+
+    for (i = 0; i < n; ++i) {
+        struct adv_session *s = &g->s[i];
+
+        adv_step(s, commands[actions[i]]);
+        g->done[i] = (unsigned char)single_over(s);
+        if (g->done[i])
+            single_start(g, i);
+        g->loc[i] = s->g.loc;
+        g->idwarf[i] = s->g.idwarf;
+        for (k = 0; k < ADV_OBJECTS; ++k) {
+            g->iplace[k * n + i] = s->g.iplace[k];
+            g->prop[k * n + i] = s->g.prop[k];
+        }
+        for (k = 0; k < 11; ++k)
+            g->dloc[k * n + i] = s->g.dloc[k];
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static int same(const struct single *g, const struct adv_batch *b, int n)
+{
+    return memcmp(g->loc, b->loc, (size_t)n * sizeof(int)) == 0
+        && memcmp(g->idwarf, b->idwarf, (size_t)n * sizeof(int)) == 0
+        && memcmp(g->iplace, b->iplace, (size_t)n * ADV_OBJECTS * sizeof(int)) == 0
+        && memcmp(g->prop, b->prop, (size_t)n * ADV_OBJECTS * sizeof(int)) == 0
+        && memcmp(g->dloc, b->dloc, (size_t)n * 11 * sizeof(int)) == 0
+        && memcmp(g->done, b->done, (size_t)n) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    const struct adv_world *w = adv_world_default();
+    struct single single;
+    struct adv_batch batch;
+    int n = argc > 1 ? atoi(argv[1]) : 1024;
+    int steps = argc > 2 ? atoi(argv[2]) : 1000;
+    int *actions;
+    unsigned long ended = 0;
+    double t0, t_single, t_batch;
+    int i, t, ncommands;
+
+    if (n < 1 || steps < 1) {
+        fprintf(stderr, "usage: %s [games] [steps]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    ncommands = adv_world_commands(w, commands, MAX_COMMANDS);
+    if (ncommands > MAX_COMMANDS)
+        ncommands = MAX_COMMANDS;
+    for (nwords = 0; nwords < ncommands && !strchr(commands[nwords], ' '); ++nwords)
+        adv_command_parse(&parsed[nwords], commands[nwords]);
+    actions = malloc((size_t)n * sizeof(*actions));
+    if (!actions)
+        return EXIT_FAILURE;
+
+    /* both play the same games */
+    single_init(&single, w, n, 1);
+    if (adv_batch_init(&batch, w, n, 1) != 0)
+        return EXIT_FAILURE;
+    for (t = 0; t < steps; ++t) {
+        pick_actions(actions, n, t);
+        single_step(&single, n, actions);
+        adv_batch_step(&batch, parsed, actions);
+        if (!same(&single, &batch, n)) {
+            fprintf(stderr, "batchbench: the games differ at step %d\n", t);
+            return EXIT_FAILURE;
+        }
+        for (i = 0; i < n; ++i)
+            ended += batch.done[i];
+    }
+    printf("%d games, %d steps: the same both ways, %lu games ended\n", n, steps, ended);
+
+    /* and are timed on, from where they are */
+    t_single = t_batch = 0;
+    for (t = steps; t < 2 * steps; ++t) {
+        pick_actions(actions, n, t);
+        t0 = now();
+        single_step(&single, n, actions);
+        t_single += now() - t0;
+        t0 = now();
+        adv_batch_step(&batch, parsed, actions);
+        t_batch += now() - t0;
+    }
+    printf("one at a time: %10.0f steps/s\n", (double)n * steps / t_single);
+    printf("adv_batch:     %10.0f steps/s  (%.2fx)\n", (double)n * steps / t_batch,
+           t_single / t_batch);
+    adv_batch_free(&batch);
+    free(actions);
+    return 0;
+}
@@ -0,0 +1,329 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    explore: breadth-first exploration of every state the game can reach.
+
+    From the start of the game it tries every command of the vocabulary
+    (adv_world_commands()) in every state found, and both outcomes of every
+    random event on the way (adv_session_chance()), level by level up to a
+    number of commands. States are told apart by adv_session_hash(), so
+    states differing only in what the game would print are one state.
+    Every state of a level is expanded in parallel: the states are shared
+    out by work stealing (steal.h), and the threads record what they find
+    in one lock-free hash set. It reports how many states each level adds,
+    how many of the moves lead to the player's death, and the shortest way
+    to a state meeting the goal given, if any.
+
+        cc -std=c11 -O2 -pthread -DADVENT_NO_MAIN advent.c steal.c explore.c -o explore
+        ./explore -depth 6 -goal hold=NUGGET
+
+    Options: -depth N (commands, default 6), -max N (states kept in all,
+    default 100000; exploring stops when they are all used), -threads N
+    (default: every CPU), -goal SPEC (see adv_goal_parse() in advent.h),
+    -world FILE (a world image).
+*/
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "advent.h"
+#include "steal.h"
+
+#define MAX_THREADS 256
+#define MAX_COMMANDS 1024
+#define MAX_DEPTH 64
+
+/* ------------------------------------------------------------------------- */
+/* Visited states                                                            */
+/* ------------------------------------------------------------------------- */
+
+/* An open-addressing set of 64-bit keys, 0 meaning an empty slot, that
+   any number of threads add to with compare-and-swap. */
+static _Atomic uint64_t *seen;
+static size_t seen_mask;
+
+/* Add KEY to the set; 1 if it was not there before. */
+static int seen_add(uint64_t key)
+{
+    size_t i;
+
+    if (key == 0)
+        key = 1;
+    for (i = (size_t)adv_mix64(key) & seen_mask;; i = (i + 1) & seen_mask) {
+        uint64_t cur = atomic_load_explicit(&seen[i], memory_order_relaxed);
+        if (cur == key)
+            return 0;
+        if (cur == 0) {
+            if (atomic_compare_exchange_strong(&seen[i], &cur, key))
+                return 1;
+            if (cur == key)
+                return 0;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Levels                                                                    */
+/* ------------------------------------------------------------------------- */
+
+/* How a state was first reached: from state PARENT of the level before,
+   by command CMD with random outcomes BITS (LEN of them). */
+struct node {
+    uint32_t parent;
+    uint16_t cmd;
+    uint8_t len;
+    uint32_t bits;
+};
+
+static const struct adv_world *world;
+static struct adv_goal goal;
+static int have_goal;
+static char commands[MAX_COMMANDS + 2][ADV_COMMAND_SIZE];
+static int ncommands;           /* then "YES" and "NO" */
+static size_t max_states;
+static size_t kept;             /* states found before the level being added */
+
+static struct node *nodes[MAX_DEPTH + 1];
+static unsigned char *saves, *next_saves; /* the states of this level and the next */
+static size_t count[MAX_DEPTH + 1];
+static int depth;                /* level being expanded */
+
+static atomic_size_t next_count;
+static atomic_size_t deaths;
+static atomic_int full;
+static atomic_long goal_node;   /* index in the level after depth, or -1 */
+static int goal_depth = -1;
+
+static struct steal_pool pool; /* the states of the level */
+static int nthreads;
+
+/* Record the state S reached from state PARENT if it is new. */
+static void add_state(const struct adv_session *s, size_t parent, int cmd,
+                      const struct adv_chance_path *path)
+{
+    size_t i;
+    struct node *n;
+
+    if (atomic_load(&full) || !seen_add(adv_session_key(s)))
+        return;
+    i = atomic_fetch_add(&next_count, 1);
+    if (kept + i >= max_states) {
+        atomic_store(&full, 1);
+        return;
+    }
+    adv_session_save(s, next_saves + i * ADV_SAVE_SIZE);
+    n = &nodes[depth + 1][i];
+    n->parent = (uint32_t)parent;
+    n->cmd = (uint16_t)cmd;
+    n->len = (uint8_t)path->len;
+    n->bits = path->bits;
+    if (have_goal && adv_goal_met(&goal, s)) {
+        long none = -1;
+        atomic_compare_exchange_strong(&goal_node, &none, (long)i);
+    }
+}
+
+static void *worker(void *arg)
+{
+    int t = (int)(intptr_t)arg;
+    struct adv_session base, child;
+    struct adv_chance_path path;
+    uint16_t events[1024];
+    int64_t idx;
+
+    adv_session_init(&base, world);
+    adv_session_init(&child, world);
+    adv_session_headless(&child, events, sizeof(events) / sizeof(events[0]));
+    adv_session_chance(&base, adv_chance_path_take, &path);
+
+    while ((idx = steal_next(&pool, t)) >= 0 && !atomic_load(&full)) {
+        int c, first, last;
+
+        if (adv_session_restore(&base, saves + (size_t)idx * ADV_SAVE_SIZE) != 0)
+            exit(EXIT_FAILURE);
+        first = base.prompt == ADV_PROMPT_YES ? ncommands : 0;
+        last = base.prompt == ADV_PROMPT_YES ? ncommands + 2 : ncommands;
+        for (c = first; c < last && !atomic_load(&full); ++c) {
+            adv_chance_path_start(&path);
+            do {
+                adv_session_fork(&child, &base);
+                adv_step(&child, commands[c]);
+                if (adv_session_over(&child))
+                    atomic_fetch_add(&deaths, 1);
+                else
+                    add_state(&child, (size_t)idx, c, &path);
+            } while (adv_chance_path_next(&path));
+        }
+    }
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static void *xmalloc(size_t size)
+{
+    void *p = calloc(1, size);
+    if (!p) {
+        fprintf(stderr, "explore: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/* Print the commands leading to state I of level D. */
+static void print_path(int d, size_t i)
+{
+    const struct node *n;
+    int k;
+
+    if (d == 0)
+        return;
+    n = &nodes[d][i];
+    print_path(d - 1, n->parent);
+    printf("    %-12s", commands[n->cmd]);
+    if (n->len > 0) {
+        printf("  random:");
+        for (k = 0; k < n->len; ++k)
+            printf(" %s", (n->bits >> k) & 1 ? "yes" : "no");
+    }
+    printf("\n");
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    static pthread_t threads[MAX_THREADS];
+    struct adv_session s;
+    uint16_t events[1024];
+    const char *world_path = NULL;
+    const char *goal_spec = NULL;
+    int max_depth = 6;
+    size_t size, d_states;
+    double t0;
+    int i, d;
+
+    max_states = 100000;
+    nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-depth") == 0 && i + 1 < argc) {
+            max_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-max") == 0 && i + 1 < argc) {
+            max_states = (size_t)atol(argv[++i]);
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-goal") == 0 && i + 1 < argc) {
+            goal_spec = argv[++i];
+        } else if (strcmp(argv[i], "-world") == 0 && i + 1 < argc) {
+            world_path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-depth N] [-max N] [-threads N] [-goal SPEC] [-world FILE]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_depth < 0 || max_depth > MAX_DEPTH || max_states < 1 || max_states > UINT32_MAX) {
+        fprintf(stderr, "explore: -depth must be 0..%d and -max 1..%lu\n",
+                MAX_DEPTH, (unsigned long)UINT32_MAX);
+        return EXIT_FAILURE;
+    }
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    if (world_path) {
+        world = adv_world_map_image(world_path);
+        if (!world)
+            return EXIT_FAILURE;
+    } else {
+        world = adv_world_default();
+    }
+    if (goal_spec) {
+        if (adv_goal_parse(&goal, world, goal_spec) != 0)
+            return EXIT_FAILURE;
+        have_goal = 1;
+    }
+    ncommands = adv_world_commands(world, commands, MAX_COMMANDS);
+    if (ncommands > MAX_COMMANDS)
+        ncommands = MAX_COMMANDS;
+    strcpy(commands[ncommands], "YES");
+    strcpy(commands[ncommands + 1], "NO");
+
+    for (size = 65536; size < 2 * max_states; size *= 2)
+        ;
+    seen = xmalloc(size * sizeof(*seen));
+    seen_mask = size - 1;
+    saves = xmalloc(max_states * ADV_SAVE_SIZE);
+    next_saves = xmalloc(max_states * ADV_SAVE_SIZE);
+
+    /* level 0: the game as it starts, at its first command */
+    adv_session_init(&s, world);
+    adv_session_headless(&s, events, sizeof(events) / sizeof(events[0]));
+    adv_step(&s, "");
+    seen_add(adv_session_key(&s));
+    adv_session_save(&s, saves);
+    nodes[0] = xmalloc(sizeof(struct node));
+    count[0] = 1;
+    kept = 1;
+    atomic_store(&goal_node, -1);
+    if (have_goal && adv_goal_met(&goal, &s))
+        goal_depth = 0;
+
+    printf("%d commands, %d threads\n", ncommands, nthreads);
+    t0 = now();
+    for (d = 0; d < max_depth && count[d] > 0 && !atomic_load(&full); ++d) {
+        unsigned char *tmp;
+
+        depth = d;
+        nodes[d + 1] = xmalloc(max_states * sizeof(struct node));
+        atomic_store(&next_count, 0);
+        if (steal_init(&pool, count[d], nthreads) != 0)
+            return EXIT_FAILURE;
+        for (i = 0; i < nthreads; ++i)
+            if (pthread_create(&threads[i], NULL, worker, (void *)(intptr_t)i) != 0) {
+                fprintf(stderr, "explore: cannot start threads\n");
+                return EXIT_FAILURE;
+            }
+        for (i = 0; i < nthreads; ++i)
+            pthread_join(threads[i], NULL);
+        steal_free(&pool);
+
+        d_states = atomic_load(&next_count);
+        if (d_states > max_states - kept)
+            d_states = max_states - kept;
+        count[d + 1] = d_states;
+        kept += d_states;
+        printf("depth %2d: %10lu new states, %10lu deaths so far\n", d + 1,
+               (unsigned long)d_states, (unsigned long)atomic_load(&deaths));
+        fflush(stdout);
+        if (goal_depth < 0 && atomic_load(&goal_node) >= 0) {
+            goal_depth = d + 1;
+            printf("goal reached in %d commands:\n", goal_depth);
+            print_path(goal_depth, (size_t)atomic_load(&goal_node));
+        }
+        tmp = saves;
+        saves = next_saves;
+        next_saves = tmp;
+    }
+
+    printf("reachable states: %lu%s\n", (unsigned long)kept,
+           atomic_load(&full) ? " (stopped at -max)" : d == max_depth ? " (within -depth)" : "");
+    printf("moves that kill the player: %lu\n", (unsigned long)atomic_load(&deaths));
+    if (have_goal)
+        printf("goal: %s\n", goal_depth < 0 ? "not reached"
+               : goal_depth == 0 ? "met at the start" : "reached (see above)");
+    printf("%.2f s, %.0f states/s\n", now() - t0, (double)kept / (now() - t0 + 1e-9));
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    mkworld: build-time generator for the world tables.
+
+    Parses an advdat file (by default the advdat.77-03-31 embedded in
+    advent.c) exactly as the game would at startup and writes the resulting
+    struct adv_world as a C header of const initialized data. advent.c
+    compiled with -DADVENT_PRECOMPILED includes that header instead of
+    parsing advdat, so the game starts without any parsing and the tables
+    live in .rodata, shared by every process running the binary.
+
+        cc -std=c99 -O2 -DADVENT_NO_MAIN advent.c mkworld.c -o mkworld
+        ./mkworld > advdat_world.h
+        cc -std=c99 -O2 -DADVENT_PRECOMPILED advent.c -o advent
+
+    With -image it writes a binary world image instead, which the game maps
+    at run time (advent -world FILE), so other data files can be played
+    without recompiling:
+
+        ./mkworld -image 77-03-11.img ../doc/advdat.77-03-11.txt
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "advent.h"
+
+/* ------------------------------------------------------------------------- */
+/* C source output                                                           */
+/* ------------------------------------------------------------------------- */
+
+/* Write ".NAME = { ... }," for the N ints at A, leaving out trailing zeros
+   (they are zero-initialized anyway). */
+static void put_ints(FILE *f, const char *name, const int *a, size_t n)
+{
+    size_t i, col = 0;
+
+    while (n > 0 && a[n - 1] == 0)
+        --n;
+    fprintf(f, "    .%s = {", name);
+    for (i = 0; i < n; ++i) {
+        if (col == 0)
+            fputs("\n        ", f);
+        fprintf(f, "%d,", a[i]);
+        col = (col + 1) % 12;
+    }
+    fputs("\n    },\n", f);
+}
+
+/* As put_ints() for the N uint16_t at A, with no field name. */
+static void put_u16s(FILE *f, const uint16_t *a, size_t n, const char *indent)
+{
+    size_t i;
+
+    while (n > 0 && a[n - 1] == 0)
+        --n;
+    fputs("{", f);
+    for (i = 0; i < n; ++i) {
+        if (i % 12 == 0)
+            fprintf(f, "\n%s    ", indent);
+        fprintf(f, "%u,", (unsigned)a[i]);
+    }
+    fprintf(f, "\n%s}", indent);
+}
+
+/* As put_ints() for 36-bit A5 words, written in octal like A5_SPACE. */
+static void put_a5s(FILE *f, const uint_least64_t *a, size_t n)
+{
+    size_t i;
+
+    while (n > 0 && a[n - 1] == 0)
+        --n;
+    fputs("{", f);
+    for (i = 0; i < n; ++i) {
+        if (i % 6 == 0)
+            fputs("\n            ", f);
+        fprintf(f, "0%llo,", (unsigned long long)a[i]);
+    }
+    fputs("\n        }", f);
+}
+
+/* Write the N bytes of text at P as a string literal, a line of it to a
+   line of source. */
+static void put_text(FILE *f, const char *p, size_t n)
+{
+    size_t i;
+
+    fputs("    .text =\n        \"", f);
+    for (i = 0; i < n; ++i) {
+        unsigned char c = (unsigned char)p[i];
+        if (c == '\n')
+            fputs(i + 1 < n ? "\\n\"\n        \"" : "\\n", f);
+        else if (c == '"' || c == '\\' || (c == '?' && i > 0 && p[i - 1] == '?'))
+            fprintf(f, "\\%c", c);   /* "?" too, or ??x could be a trigraph */
+        else if (c < ' ' || c > '~')
+            fprintf(f, "\\%03o", c);
+        else
+            putc(c, f);
+    }
+    fputs("\",\n", f);
+}
+
+/* Write G, the game as it starts: only the fields game_start() sets, so
+   stop if any other is not zero. */
+static void put_start(FILE *f, const struct adv_game *g)
+{
+    static const struct adv_game zero;
+    struct adv_game rest;
+    int i;
+
+    memcpy(&rest, g, sizeof(rest));
+    memset(rest.iplace, 0, sizeof(rest.iplace));
+    memset(rest.here, 0, sizeof(rest.here));
+    memset(rest.stamp, 0, sizeof(rest.stamp));
+    rest.nstamp = 0;
+    rest.ifirst = 0;
+    rest.ilong = 0;
+    rest.hash = 0;
+    if (memcmp(&rest, &zero, sizeof(rest)) != 0) {
+        fprintf(stderr, "mkworld: put_start() does not write all of struct adv_game\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fputs("    .start = {\n", f);
+    put_ints(f, "iplace", g->iplace, ADV_OBJECTS);
+    fputs("    .here = {\n", f);
+    for (i = 0; i < 301; ++i)
+        if (g->here[i] != 0)
+            fprintf(f, "        [%d] = 0x%08lxUL,\n", i, (unsigned long)g->here[i]);
+    fputs("    },\n", f);
+    put_ints(f, "stamp", g->stamp, ADV_OBJECTS);
+    fprintf(f, "    .nstamp = %d,\n", g->nstamp);
+    fprintf(f, "    .ifirst = %d,\n", g->ifirst);
+    fprintf(f, "    .ilong = %d,\n", g->ilong);
+    fprintf(f, "    .hash = 0x%016llxULL,\n", (unsigned long long)g->hash);
+    fputs("    },\n", f);
+}
+
+static void write_world_c(FILE *f, const struct adv_world *w, const char *src)
+{
+    size_t i;
+
+    fprintf(f,
+        "/* Generated by mkworld from %s. Do not edit. */\n"
+        "\n"
+        "static const struct adv_world advdat_world = {\n", src);
+
+    put_ints(f, "ifixed", w->ifixed, 101);
+    put_ints(f, "rtext_tab", w->rtext_tab, 101);
+    put_ints(f, "btext", w->btext, 201);
+    put_ints(f, "cond", w->cond, 301);
+    put_ints(f, "default_", w->default_, 301);
+    put_ints(f, "key", w->key, 301);
+    put_ints(f, "ltext", w->ltext, 301);
+    put_ints(f, "stext", w->stext, 301);
+    put_ints(f, "ktab", w->ktab, 1001);
+    put_ints(f, "travel", w->travel, 1001);
+
+    put_text(f, w->text, (size_t)w->text_size);
+    fprintf(f, "    .text_size = %d,\n", w->text_size);
+    fputs("    .text_off = ", f);
+    put_u16s(f, w->text_off, 1001, "    ");
+    fputs(",\n    .text_len = ", f);
+    put_u16s(f, w->text_len, 1001, "    ");
+    fputs(",\n", f);
+
+    fputs("    .atab = ", f);
+    put_a5s(f, w->atab, 1001);
+    fputs(",\n", f);
+
+    fprintf(f, "    .vocab_salt = %lluULL,\n", (unsigned long long)w->vocab_salt);
+    fprintf(f, "    .vocab_n = %d,\n", w->vocab_n);
+    fprintf(f, "    .vocab_buckets = %d,\n", w->vocab_buckets);
+    fputs("    .vocab_disp = {\n", f);
+    for (i = 0; i < (size_t)w->vocab_buckets; ++i)
+        fprintf(f, "        {%u,%u},\n",
+                (unsigned)w->vocab_disp[i][0], (unsigned)w->vocab_disp[i][1]);
+    fputs("    },\n", f);
+    fputs("    .vocab_slot = ", f);
+    put_u16s(f, w->vocab_slot, 1000, "    ");
+    fputs(",\n", f);
+
+    fputs("    .motion = {\n", f);
+    for (i = 0; i < 301; ++i) {
+        size_t k;
+        for (k = 0; k < ADV_MOTIONS && w->motion[i][k] == 0; ++k)
+            ;
+        if (k == ADV_MOTIONS)
+            continue;
+        fprintf(f, "        [%u] = ", (unsigned)i);
+        put_u16s(f, w->motion[i], ADV_MOTIONS, "        ");
+        fputs(",\n", f);
+    }
+    fputs("    },\n", f);
+
+    put_start(f, &w->start);
+    fputs("};\n", f);
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+/* Return the whole of file PATH as a NUL-terminated string. */
+static char *read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    char *text;
+    long len;
+
+    if (!f) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0
+        || fseek(f, 0, SEEK_SET) != 0) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    text = malloc((size_t)len + 1);
+    if (!text || fread(text, 1, (size_t)len, f) != (size_t)len) {
+        fprintf(stderr, "%s: read failed\n", path);
+        exit(EXIT_FAILURE);
+    }
+    text[len] = '\0';
+    fclose(f);
+    return text;
+}
+
+int main(int argc, char **argv)
+{
+    static struct adv_world world;
+    const char *src = "advdat.77-03-31";
+    const char *text = advdat_77_03_31;
+    const char *outpath = NULL;
+    const char *imagepath = NULL;
+    FILE *out = stdout;
+    int i;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outpath = argv[++i];
+        } else if (strcmp(argv[i], "-image") == 0 && i + 1 < argc) {
+            imagepath = argv[++i];
+        } else if (argv[i][0] != '-' && text == advdat_77_03_31) {
+            src = argv[i];
+            text = read_file(src);
+        } else {
+            fprintf(stderr, "usage: %s [-o out.h | -image out.img] [advdat-file]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    adv_world_load(&world, text);
+    if (imagepath)
+        return adv_world_save_image(&world, imagepath) == 0 ? 0 : EXIT_FAILURE;
+
+    if (outpath && !(out = fopen(outpath, "w"))) {
+        perror(outpath);
+        return EXIT_FAILURE;
+    }
+    write_world_c(out, &world, src);
+    if (fflush(out) != 0 || (outpath && fclose(out) != 0)) {
+        perror(outpath ? outpath : "stdout");
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
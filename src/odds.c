@@ -0,0 +1,231 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    odds: the exact chances of what a script of commands leads to.
+
+    Rather than playing the script over and over with different seeds, it
+    follows both outcomes of every random event (adv_session_chance()) with
+    the probability the game gives it, and after each command merges the
+    games that have come to the same state (adv_session_hash()), adding up
+    their probabilities. What it holds after each command is then the
+    exact distribution of states the game can be in, usually a few hundred
+    at most, and from that it prints the chance of having died so far,
+    and at the end where the player can be and the chance of the goal.
+
+        cc -std=c99 -O2 -DADVENT_NO_MAIN advent.c odds.c -o odds
+        ./odds -goal hold=NUGGET walk.txt
+
+    The script is read from the file given or from stdin, one command (or
+    answer) to a line, played from the first command of the game.
+    Options: -goal SPEC (see adv_goal_parse() in advent.h), -min P (drop
+    states less likely than P, and report how much was dropped; default 0,
+    exact), -world FILE (a world image).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "advent.h"
+
+/* ------------------------------------------------------------------------- */
+/* Distributions of states                                                   */
+/* ------------------------------------------------------------------------- */
+
+/* N states, each a saved session with its probability and whether the
+   player has died on the way to it, and an index of them by key. */
+struct dist {
+    unsigned char *saves;
+    double *p;
+    unsigned char *died;
+    size_t n, cap;
+    size_t *index;              /* slot -> state + 1, 0 if empty */
+    uint64_t *keys;
+    size_t mask;
+};
+
+static void *xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (!p) {
+        fprintf(stderr, "odds: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void dist_clear(struct dist *d)
+{
+    d->n = 0;
+    if (d->index)
+        memset(d->index, 0, (d->mask + 1) * sizeof(*d->index));
+}
+
+/* Grow D to room for twice as many states, the index to twice that. */
+static void dist_grow(struct dist *d)
+{
+    size_t i, size;
+
+    d->cap = d->cap ? 2 * d->cap : 256;
+    d->saves = xrealloc(d->saves, d->cap * ADV_SAVE_SIZE);
+    d->p = xrealloc(d->p, d->cap * sizeof(*d->p));
+    d->died = xrealloc(d->died, d->cap);
+    d->keys = xrealloc(d->keys, d->cap * sizeof(*d->keys));
+
+    size = 2 * d->cap;
+    d->mask = size - 1;
+    d->index = xrealloc(d->index, size * sizeof(*d->index));
+    memset(d->index, 0, size * sizeof(*d->index));
+    for (i = 0; i < d->n; ++i) {
+        size_t slot = (size_t)adv_mix64(d->keys[i]) & d->mask;
+        while (d->index[slot] != 0)
+            slot = (slot + 1) & d->mask;
+        d->index[slot] = i + 1;
+    }
+}
+
+/* Add the game in S, reached with probability P, to D, or add P to the
+   same state already there. */
+static void dist_add(struct dist *d, const struct adv_session *s, double p, int died)
+{
+    uint64_t key = adv_session_key(s) ^ (died ? 0x9E3779B97F4A7C15ULL : 0);
+    size_t slot, i;
+
+    if (d->n == d->cap)
+        dist_grow(d);
+    for (slot = (size_t)adv_mix64(key) & d->mask; d->index[slot] != 0; slot = (slot + 1) & d->mask) {
+        i = d->index[slot] - 1;
+        if (d->keys[i] == key) {
+            d->p[i] += p;
+            return;
+        }
+    }
+    i = d->n++;
+    d->index[slot] = i + 1;
+    d->keys[i] = key;
+    d->p[i] = p;
+    d->died[i] = (unsigned char)died;
+    adv_session_save(s, d->saves + i * ADV_SAVE_SIZE);
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static int by_p_desc(const void *a, const void *b)
+{
+    double x = ((const double *)a)[1], y = ((const double *)b)[1];
+    return (x < y) - (x > y);
+}
+
+int main(int argc, char **argv)
+{
+    static struct dist dists[2];
+    struct dist *cur = &dists[0], *next = &dists[1], *tmp;
+    struct adv_session base, child;
+    struct adv_chance_path path;
+    struct adv_goal goal;
+    uint16_t events[1024];
+    const struct adv_world *world;
+    const char *world_path = NULL;
+    const char *goal_spec = NULL;
+    const char *script = NULL;
+    double min_p = 0, dropped = 0, p_died, p_goal, rooms[301][2];
+    char line[256];
+    FILE *f = stdin;
+    size_t i;
+    int turn = 0, nrooms, r;
+
+    for (i = 1; i < (size_t)argc; ++i) {
+        if (strcmp(argv[i], "-goal") == 0 && i + 1 < (size_t)argc) {
+            goal_spec = argv[++i];
+        } else if (strcmp(argv[i], "-min") == 0 && i + 1 < (size_t)argc) {
+            min_p = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-world") == 0 && i + 1 < (size_t)argc) {
+            world_path = argv[++i];
+        } else if (argv[i][0] != '-' && !script) {
+            script = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [-goal SPEC] [-min P] [-world FILE] [script]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (world_path) {
+        world = adv_world_map_image(world_path);
+        if (!world)
+            return EXIT_FAILURE;
+    } else {
+        world = adv_world_default();
+    }
+    if (goal_spec && adv_goal_parse(&goal, world, goal_spec) != 0)
+        return EXIT_FAILURE;
+    if (script && !(f = fopen(script, "r"))) {
+        perror(script);
+        return EXIT_FAILURE;
+    }
+
+    adv_session_init(&base, world);
+    adv_session_init(&child, world);
+    adv_session_headless(&child, events, sizeof(events) / sizeof(events[0]));
+    adv_session_chance(&base, adv_chance_path_take, &path);
+    adv_chance_path_start(&path);
+    adv_session_fork(&child, &base);
+    adv_step(&child, "");
+    dist_add(cur, &child, path.p, 0);
+
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        dist_clear(next);
+        for (i = 0; i < cur->n; ++i) {
+            if (cur->p[i] < min_p) {
+                dropped += cur->p[i];
+                continue;
+            }
+            if (adv_session_restore(&base, cur->saves + i * ADV_SAVE_SIZE) != 0)
+                return EXIT_FAILURE;
+            adv_chance_path_start(&path);
+            do {
+                adv_session_fork(&child, &base);
+                adv_step(&child, line);
+                dist_add(next, &child, cur->p[i] * path.p, cur->died[i] || adv_session_over(&child));
+            } while (adv_chance_path_next(&path));
+        }
+        tmp = cur;
+        cur = next;
+        next = tmp;
+
+        p_died = 0;
+        for (i = 0; i < cur->n; ++i)
+            if (cur->died[i])
+                p_died += cur->p[i];
+        printf("%4d  %-20s %8lu states   P(died) %.6f\n",
+               ++turn, line, (unsigned long)cur->n, p_died);
+    }
+    if (f != stdin)
+        fclose(f);
+
+    /* where the player is, most likely first */
+    memset(rooms, 0, sizeof(rooms));
+    p_died = p_goal = 0;
+    for (i = 0; i < cur->n; ++i) {
+        if (adv_session_restore(&base, cur->saves + i * ADV_SAVE_SIZE) != 0)
+            return EXIT_FAILURE;
+        r = base.g.loc >= 0 && base.g.loc <= 300 ? base.g.loc : 0;
+        rooms[r][0] = r;
+        rooms[r][1] += cur->p[i];
+        if (cur->died[i])
+            p_died += cur->p[i];
+        if (goal_spec && adv_goal_met(&goal, &base))
+            p_goal += cur->p[i];
+    }
+    qsort(rooms, 301, sizeof(rooms[0]), by_p_desc);
+    printf("\nP(died) %.6f\n", p_died);
+    if (goal_spec)
+        printf("P(goal) %.6f\n", p_goal);
+    if (dropped > 0)
+        printf("dropped %.6f (states less likely than %g)\n", dropped, min_p);
+    printf("room     P\n");
+    for (nrooms = 0; nrooms < 301 && rooms[nrooms][1] > 0; ++nrooms)
+        printf("%4d  %.6f\n", (int)rooms[nrooms][0], rooms[nrooms][1]);
+    return 0;
+}
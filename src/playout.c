@@ -0,0 +1,414 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    playout: many games played at random, on all the CPUs, and what became
+    of them.
+
+    Game I of a run is seeded with adv_ran_split(SEED, I), so a run gives
+    the same numbers whatever the number of threads, and any one game can
+    be replayed on its own. Each game is driven by a policy, which picks
+    the player's next command: a script, or one of the random policies
+    over the vocabulary (adv_world_commands()). It plays headless until
+    the player first dies or the turns run out, and the run reports how
+    the players died (by the message the game gave), how long they lived,
+    how often the dwarves turned up and threw knives, and which rooms they
+    reached. The games are shared out by work stealing (steal.h), so the
+    odd long game does not leave the other threads idle at the end.
+
+        cc -std=c11 -O2 -pthread -DADVENT_NO_MAIN advent.c steal.c playout.c -o playout
+        ./playout -games 100000 -policy words
+
+    Options: -games N (default 10000), -seed N (default 1), -turns N (most
+    commands a game, default 200), -policy random|words (any command, or
+    only the one-word ones, which mostly move; default random), -script
+    FILE (the same commands for every game instead of a policy), -threads N
+    (default: every CPU), -world FILE (a world image).
+*/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "advent.h"
+#include "steal.h"
+
+#define MAX_THREADS 256
+#define MAX_COMMANDS 1024
+#define MAX_SCRIPT 4096
+#define MAX_TURNS 100000
+#define MESSAGES 101            /* speak() takes messages 1..100 */
+
+/* ------------------------------------------------------------------------- */
+/* Policies                                                                  */
+/* ------------------------------------------------------------------------- */
+
+/* A player: the policy that picks its commands, and its own random
+   numbers for the policy to use. */
+struct player {
+    const char *(*next)(struct player *p, const struct adv_session *s, int turn);
+    uint64_t ran;               /* the player's own random numbers */
+};
+
+static char commands[MAX_COMMANDS][ADV_COMMAND_SIZE];
+static int ncommands, nwords;   /* the first nwords are one word each */
+static char *script[MAX_SCRIPT];
+static int nscript;
+
+static uint64_t player_ran(struct player *p, uint64_t n)
+{
+    return (adv_mix64(p->ran += 0x9E3779B97F4A7C15ULL) >> 11) % n;
+}
+
+static const char *yes_or_no(struct player *p)
+{
+    return player_ran(p, 2) ? "YES" : "NO";
+}
+
+/* Any command at all. */
+static const char *policy_random(struct player *p, const struct adv_session *s, int turn)
+{
+    (void)turn;
+    if (s->prompt == ADV_PROMPT_YES)
+        return yes_or_no(p);
+    return commands[player_ran(p, (uint64_t)ncommands)];
+}
+
+/* One-word commands only: motions, and verbs that need no object. */
+static const char *policy_words(struct player *p, const struct adv_session *s, int turn)
+{
+    (void)turn;
+    if (s->prompt == ADV_PROMPT_YES)
+        return yes_or_no(p);
+    return commands[player_ran(p, (uint64_t)nwords)];
+}
+
+/* The lines of the script, then nothing more. */
+static const char *policy_script(struct player *p, const struct adv_session *s, int turn)
+{
+    (void)p;
+    (void)s;
+    return turn < nscript ? script[turn] : NULL;
+}
+
+static const struct {
+    const char *name;
+    const char *(*next)(struct player *, const struct adv_session *, int);
+} policies[] = {
+    {"random", policy_random},
+    {"words", policy_words},
+};
+
+/* ------------------------------------------------------------------------- */
+/* Playing                                                                   */
+/* ------------------------------------------------------------------------- */
+
+/* What became of a number of games. */
+struct stats {
+    unsigned long games, died, turns, died_turns;
+    unsigned long cause[MESSAGES];  /* deaths by the message before them */
+    unsigned long knifed;           /* deaths to a dwarf's knife */
+    unsigned long met, met_games;   /* turns the dwarves showed up */
+    unsigned long knives, hits;
+    unsigned long reached[301];     /* games that reached each room */
+    unsigned long rooms;            /* rooms reached, summed over games */
+};
+
+static const struct adv_world *world;
+static const char *(*policy)(struct player *, const struct adv_session *, int);
+static unsigned long ngames;
+static int max_turns;
+static uint64_t seed;
+static struct steal_pool pool;
+static struct stats thread_stats[MAX_THREADS];
+
+/* Count room LOC as reached in ST, unless SEEN says the game has been
+   there already. */
+static void reach(struct stats *st, unsigned char seen[301], int loc)
+{
+    if (loc > 0 && loc <= 300 && !seen[loc]) {
+        seen[loc] = 1;
+        ++st->reached[loc];
+        ++st->rooms;
+    }
+}
+
+/* Play game I in S and add what became of it to ST. */
+static void play_game(struct adv_session *s, unsigned long i, struct stats *st)
+{
+    struct player p;
+    unsigned char seen[301] = {0};
+    int turn, met = 0;
+
+    p.next = policy;
+    p.ran = adv_ran_split(seed ^ 0x5DEECE66DULL, i);
+    adv_session_reset(s);
+    adv_session_seed(s, adv_ran_split(seed, i));
+    adv_step(s, "");
+    reach(st, seen, s->g.loc);  /* where the player starts */
+
+    for (turn = 0; turn < max_turns; ++turn) {
+        const char *input = p.next(&p, s, turn);
+        int said = 0, hit = 0, cause = -1;
+        size_t e;
+
+        if (!input || s->prompt == ADV_PROMPT_OVER)
+            break;
+        adv_step(s, input);
+        for (e = 0; e < s->evlen; ++e) {
+            int kind = ADV_EV_KIND(s->events[e]), arg = ADV_EV_ARG(s->events[e]);
+            switch (kind) {
+            case ADV_EV_SPEAK:
+                /* a lone dwarf is only spoken of: 4 it is here, 5 it
+                   throws, 53 it hits; 6 one of several hits */
+                said = arg;
+                if (arg == 4)
+                    ++met;
+                else if (arg == 5)
+                    ++st->knives;
+                else if (arg == 53 || arg == 6)
+                    ++hit;
+                break;
+            case ADV_EV_DWARVES:
+                ++met;
+                break;
+            case ADV_EV_KNIVES:
+                st->knives += (unsigned long)arg;
+                break;
+            case ADV_EV_HITS:
+                hit += arg;
+                break;
+            case ADV_EV_PAUSE:
+                /* what was said last before the game paused, should
+                   the pause be for the player's death */
+                if (cause < 0)
+                    cause = said;
+                break;
+            }
+        }
+        reach(st, seen, s->g.loc);
+        st->hits += (unsigned long)hit;
+        if (adv_session_over(s)) {
+            ++st->died;
+            st->died_turns += (unsigned long)turn + 1;
+            if (hit)
+                ++st->knifed;
+            else
+                ++st->cause[cause > 0 && cause < MESSAGES ? cause : 0];
+            ++turn;
+            break;
+        }
+    }
+    ++st->games;
+    st->turns += (unsigned long)turn;
+    st->met += (unsigned long)met;
+    st->met_games += met > 0;
+}
+
+static void *worker(void *arg)
+{
+    int t = (int)(intptr_t)arg;
+    struct stats *st = &thread_stats[t];
+    struct adv_session s;
+    uint16_t events[1024];
+    int64_t i;
+
+    adv_session_init(&s, world);
+    adv_session_headless(&s, events, sizeof(events) / sizeof(events[0]));
+    while ((i = steal_next(&pool, t)) >= 0)
+        play_game(&s, (unsigned long)i, st);
+    adv_session_free(&s);
+    return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Read the script at PATH, one command to a line. */
+static int read_script(const char *path)
+{
+    char line[256];
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (nscript < MAX_SCRIPT && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!(script[nscript] = malloc(strlen(line) + 1))) {
+            fprintf(stderr, "playout: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        strcpy(script[nscript++], line);
+    }
+    fclose(f);
+    return 0;
+}
+
+/* Print the first line of message IT. */
+static void print_message(int it)
+{
+    int line = it > 0 && it < 101 ? world->rtext_tab[it] : 0;
+    int len;
+
+    if (line == 0) {
+        printf("(other)\n");
+        return;
+    }
+    len = world->text_len[line];
+    while (len > 0 && (world->text[world->text_off[line] + len - 1] == ' '
+                       || world->text[world->text_off[line] + len - 1] == '\n'))
+        --len;
+    printf("%.*s\n", len, world->text + world->text_off[line]);
+}
+
+int main(int argc, char **argv)
+{
+    static pthread_t threads[MAX_THREADS];
+    static struct stats total;
+    const char *world_path = NULL;
+    const char *script_path = NULL;
+    const char *policy_name = "random";
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double t0, secs;
+    int i, t, r;
+
+    ngames = 10000;
+    seed = 1;
+    max_turns = 200;
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-games") == 0 && i + 1 < argc) {
+            ngames = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-turns") == 0 && i + 1 < argc) {
+            max_turns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-policy") == 0 && i + 1 < argc) {
+            policy_name = argv[++i];
+        } else if (strcmp(argv[i], "-script") == 0 && i + 1 < argc) {
+            script_path = argv[++i];
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-world") == 0 && i + 1 < argc) {
+            world_path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-games N] [-seed N] [-turns N] [-policy random|words] [-script FILE] [-threads N] [-world FILE]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (max_turns < 1 || max_turns > MAX_TURNS) {
+        fprintf(stderr, "playout: -turns must be 1..%d\n", MAX_TURNS);
+        return EXIT_FAILURE;
+    }
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    for (i = 0; i < (int)(sizeof(policies) / sizeof(policies[0])); ++i)
+        if (strcmp(policy_name, policies[i].name) == 0)
+            policy = policies[i].next;
+    if (!policy) {
+        fprintf(stderr, "playout: no policy %s\n", policy_name);
+        return EXIT_FAILURE;
+    }
+    if (script_path) {
+        if (read_script(script_path) != 0)
+            return EXIT_FAILURE;
+        policy = policy_script;
+    }
+    if (world_path) {
+        world = adv_world_map_image(world_path);
+        if (!world)
+            return EXIT_FAILURE;
+    } else {
+        world = adv_world_default();
+    }
+    ncommands = adv_world_commands(world, commands, MAX_COMMANDS);
+    if (ncommands > MAX_COMMANDS)
+        ncommands = MAX_COMMANDS;
+    for (nwords = 0; nwords < ncommands && !strchr(commands[nwords], ' '); ++nwords)
+        ;
+
+    if (steal_init(&pool, ngames, nthreads) != 0)
+        return EXIT_FAILURE;
+    t0 = now();
+    for (t = 0; t < nthreads; ++t)
+        if (pthread_create(&threads[t], NULL, worker, (void *)(intptr_t)t) != 0) {
+            fprintf(stderr, "playout: cannot start threads\n");
+            return EXIT_FAILURE;
+        }
+    for (t = 0; t < nthreads; ++t)
+        pthread_join(threads[t], NULL);
+    secs = now() - t0;
+    steal_free(&pool);
+
+    for (t = 0; t < nthreads; ++t) {
+        const struct stats *st = &thread_stats[t];
+        total.games += st->games;
+        total.died += st->died;
+        total.turns += st->turns;
+        total.died_turns += st->died_turns;
+        for (i = 0; i < MESSAGES; ++i)
+            total.cause[i] += st->cause[i];
+        total.knifed += st->knifed;
+        total.met += st->met;
+        total.met_games += st->met_games;
+        total.knives += st->knives;
+        total.hits += st->hits;
+        for (r = 0; r <= 300; ++r)
+            total.reached[r] += st->reached[r];
+        total.rooms += st->rooms;
+    }
+    if (total.games == 0)
+        return 0;
+
+#define SHARE(n) (100.0 * (double)(n) / (double)total.games)
+    printf("%lu games, %s, %d threads: %.2f s, %.0f games/s, %.0f turns/s\n",
+           total.games, script_path ? "script" : policy_name, nthreads, secs,
+           (double)total.games / secs, (double)total.turns / secs);
+    printf("died: %.2f%%, after %.1f turns on average; %.1f turns a game\n",
+           SHARE(total.died), total.died ? (double)total.died_turns / (double)total.died : 0.0,
+           (double)total.turns / (double)total.games);
+    if (total.knifed > total.hits) {
+        fprintf(stderr, "playout: %lu deaths to knives but %lu hits\n", total.knifed, total.hits);
+        return EXIT_FAILURE;
+    }
+    printf("causes of death:\n");
+    if (total.knifed)
+        printf("      %7.2f%%  (a dwarf's knife)\n", SHARE(total.knifed));
+    for (i = 0; i < MESSAGES; ++i) {
+        if (total.cause[i] == 0)
+            continue;
+        printf("  %3d %7.2f%%  ", i, SHARE(total.cause[i]));
+        print_message(i);
+    }
+    printf("dwarves: met in %.2f%% of games, %.2f times a game; %lu knives thrown, %lu hit\n",
+           SHARE(total.met_games), (double)total.met / (double)total.games,
+           total.knives, total.hits);
+    printf("rooms: %.1f reached a game; reached by most games:\n",
+           (double)total.rooms / (double)total.games);
+    for (i = 0; i < 20; ++i) {
+        int best = 0;
+        for (r = 1; r <= 300; ++r)
+            if (total.reached[r] > total.reached[best])
+                best = r;
+        if (total.reached[best] == 0)
+            break;
+        printf("  %3d %7.2f%%\n", best, SHARE(total.reached[best]));
+        total.reached[best] = 0;
+    }
+#undef SHARE
+    return 0;
+}
@@ -0,0 +1,147 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    savecheck: checks adv_session_save() and adv_session_restore().
+
+    Plays games at random, headless, and at every prompt saves the game,
+    restores it into another session and checks that the two carry on
+    identically. Then it takes saves of games in progress with one field
+    set to a value the game never reaches, each an index the engine would
+    use into one of its tables, and checks that adv_session_restore()
+    turns every one of them away rather than play on from it.
+
+        cc -std=c99 -O2 -DADVENT_NO_MAIN advent.c savecheck.c -o savecheck
+        ./savecheck [games]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "advent.h"
+
+#define MAX_COMMANDS 1024
+#define TURNS 300
+#define BAD_GAMES 10            /* games whose saves are corrupted, */
+#define BAD_TURN 20             /* at this turn */
+
+static char commands[MAX_COMMANDS][ADV_COMMAND_SIZE];
+static int nwords;
+
+/* A field of a game in progress and a value it must not be restored
+   with. */
+struct bad_field {
+    const char *name;
+    int (*field)(struct adv_session *s);
+};
+
+#define BAD(name, lvalue, value) \
+    static int bad_##name(struct adv_session *s) { return (lvalue) = (value); }
+BAD(idwarf, s->g.idwarf, 100)
+BAD(idwarf_neg, s->g.idwarf, -1)
+BAD(jobj, s->g.jobj, ADV_OBJECTS)
+BAD(k, s->g.k, 101)
+BAD(l, s->g.l, 316)
+BAD(jspk, s->g.jspk, 101)
+BAD(idark, s->g.idark, 2)
+BAD(dloc, s->g.dloc[2], 301)
+BAD(odloc, s->g.odloc[1], -1)
+BAD(dseen, s->g.dseen[3], 2)
+BAD(prop, s->g.prop[5], 2)
+BAD(loc, s->g.loc, 301)
+BAD(yes_y, s->yes_y, 101)
+BAD(yes_z, s->yes_z, 1000)
+#undef BAD
+
+static const struct bad_field bad_fields[] = {
+    {"idwarf", bad_idwarf}, {"idwarf", bad_idwarf_neg}, {"jobj", bad_jobj},
+    {"k", bad_k}, {"l", bad_l}, {"jspk", bad_jspk}, {"idark", bad_idark},
+    {"dloc", bad_dloc}, {"odloc", bad_odloc}, {"dseen", bad_dseen},
+    {"prop", bad_prop}, {"loc", bad_loc}, {"yes_y", bad_yes_y},
+    {"yes_z", bad_yes_z},
+};
+
+/* The next command of game G at turn T: YES or NO at a question,
+   otherwise a one-word command, never BACK, which can leave the engine
+   going back and forth between two rooms for good when a dwarf blocks
+   the way out of one the player is forced out of. */
+static const char *pick(const struct adv_session *s, uint64_t g, int t)
+{
+    uint64_t r = adv_ran_split(g, (uint64_t)t);
+    const char *c;
+
+    if (s->prompt == ADV_PROMPT_YES)
+        return r & 1 ? "YES" : "NO";
+    c = commands[r % (uint64_t)nwords];
+    return strcmp(c, "BACK") == 0 ? "LOOK" : c;
+}
+
+int main(int argc, char **argv)
+{
+    const struct adv_world *w = adv_world_default();
+    static struct adv_session a, b, bad;
+    static unsigned char save[ADV_SAVE_SIZE], again[ADV_SAVE_SIZE];
+    uint16_t events_a[1024], events_b[1024];
+    unsigned long games = argc > 1 ? strtoul(argv[1], NULL, 0) : 2000;
+    unsigned long saves = 0, refused = 0;
+    unsigned long g;
+    int ncommands, t;
+    size_t f;
+
+    ncommands = adv_world_commands(w, commands, MAX_COMMANDS);
+    if (ncommands > MAX_COMMANDS)
+        ncommands = MAX_COMMANDS;
+    for (nwords = 0; nwords < ncommands && !strchr(commands[nwords], ' '); ++nwords)
+        ;
+    adv_session_init(&a, w);
+    adv_session_init(&b, w);
+    adv_session_headless(&a, events_a, sizeof(events_a) / sizeof(events_a[0]));
+    adv_session_headless(&b, events_b, sizeof(events_b) / sizeof(events_b[0]));
+
+    for (g = 0; g < games; ++g) {
+        adv_session_reset(&a);
+        adv_session_seed(&a, g);
+        adv_step(&a, "");
+        for (t = 0; t < TURNS && a.prompt != ADV_PROMPT_OVER; ++t) {
+            const char *input = pick(&a, g, t);
+
+            /* a restored game plays on as the saved one does */
+            adv_session_save(&a, save);
+            if (adv_session_restore(&b, save) != 0) {
+                fprintf(stderr, "savecheck: game %lu turn %d would not restore\n", g, t);
+                return EXIT_FAILURE;
+            }
+            ++saves;
+            adv_step(&a, input);
+            adv_step(&b, input);
+            adv_session_save(&a, save);
+            adv_session_save(&b, again);
+            if (a.evlen != b.evlen
+                || memcmp(a.events, b.events, a.evlen * sizeof(a.events[0])) != 0
+                || memcmp(save, again, ADV_SAVE_SIZE) != 0
+                || adv_session_hash(&a) != adv_session_hash(&b)) {
+                fprintf(stderr, "savecheck: game %lu turn %d differs once restored\n", g, t);
+                return EXIT_FAILURE;
+            }
+
+            /* and one with a field out of range is not restored (each
+               refusal is reported on stderr, so only a few of them) */
+            if (g >= BAD_GAMES || t != BAD_TURN)
+                continue;
+            for (f = 0; f < sizeof(bad_fields) / sizeof(bad_fields[0]); ++f) {
+                bad = a;
+                bad_fields[f].field(&bad);
+                adv_session_save(&bad, save);
+                if (adv_session_restore(&b, save) == 0) {
+                    fprintf(stderr, "savecheck: game %lu turn %d restored with a bad %s\n",
+                            g, t, bad_fields[f].name);
+                    return EXIT_FAILURE;
+                }
+                ++refused;
+            }
+        }
+    }
+    printf("%lu games: %lu saves restored and played on the same, %lu corrupted saves refused\n",
+           games, saves, refused);
+    return 0;
+}
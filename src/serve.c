@@ -0,0 +1,522 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    serve: a game for every connection, over TCP (or telnet), on every
+    CPU.
+
+    The main thread only accepts connections. Connection I (in the order
+    they came) belongs to shard I % N for its whole life, and is handed to
+    it through a lock-free queue the shard is woken up for. Each shard is
+    a thread with its own epoll loop, connections and buffers; the shards
+    share nothing but the world, which is read only, so they never wait
+    for one another. A shard reads what its players type, each complete
+    line is a command for the connection's session (adv_step()), and the
+    turn's output goes back in one send(). A send the socket cannot take
+    at once is kept and finished when the socket is writable again, so a
+    slow player never holds up the others, and the lines of a player
+    whose output is piling up are not read until it has gone. A
+    connection costs its session, a few KB, and nothing else while idle:
+    the output arena is given back after every turn.
+
+        cc -std=c11 -O2 -pthread -DADVENT_NO_MAIN advent.c serve.c -o serve
+        ./serve -port 4000
+        telnet localhost 4000
+
+    Options: -port N (default 4000), -seed N (seed for the games, default
+    from the clock), -max N (most connections, default 100000), -threads N
+    (shards, default: every CPU), -world FILE (a world image). Linux only
+    (epoll, eventfd). servebench.c measures how many commands a second it
+    plays.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "advent.h"
+
+#define LINE_SIZE 256
+#define EVENTS 256
+#define MAX_SHARDS 256
+#define QUEUE_SIZE 1024         /* connections waiting for a shard */
+
+/* telnet commands */
+#define IAC  255
+#define SB   250
+#define SE   240
+#define WILL 251
+
+/* ------------------------------------------------------------------------- */
+/* Connections                                                               */
+/* ------------------------------------------------------------------------- */
+
+/* A shard: one thread and its epoll loop, and the connections it runs. */
+struct shard {
+    /* connections handed over by the listener, which alone adds to the
+       tail; the shard alone takes from the head */
+    struct handoff {
+        int fd;
+        uint64_t id;
+    } queue[QUEUE_SIZE];
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    int epfd;
+    int wakefd;                 /* eventfd the listener rings */
+    char *netbuf;               /* a turn's output with newlines made CR LF */
+    size_t netcap;
+    pthread_t thread;
+};
+
+/* Where the telnet filter is in a command from the client. */
+enum telnet {
+    TN_DATA,
+    TN_IAC,                 /* after IAC */
+    TN_OPTION,              /* after IAC WILL/WONT/DO/DONT */
+    TN_SB,                  /* in a subnegotiation */
+    TN_SB_IAC               /* after IAC in a subnegotiation */
+};
+
+struct conn {
+    struct shard *sh;
+    int fd;
+    struct adv_session s;
+    char line[LINE_SIZE];       /* the line being typed */
+    size_t linelen;             /* characters past the end are dropped */
+    enum telnet tn;
+    char *pending;              /* output the socket has not taken yet */
+    size_t pendlen, pendpos;
+    unsigned char *unread;      /* input left until the pending output goes */
+    size_t unreadlen;
+    int closing;                /* the game is over: close once sent */
+    uint32_t watching;          /* the epoll events asked for */
+};
+
+static struct shard shards[MAX_SHARDS];
+static int nshards;
+static atomic_size_t nconns;
+static size_t max_conns = 100000;
+static const struct adv_world *world;
+static uint64_t seed;
+
+static const char banner[] =
+    "-----------------------------------------------------------------\r\n"
+    "     Will Crowther's original 1976 \"Colossal Cave Adventure\"\r\n"
+    "               A faithful reimplementation in C\r\n"
+    "-----------------------------------------------------------------\r\n"
+    "To quit close the connection\r\n\r\n";
+
+static void *xrealloc(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (!p) {
+        fprintf(stderr, "serve: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+/* Watch C for input, and for room to send if it has output pending. */
+static void conn_watch(struct conn *c)
+{
+    struct epoll_event ev;
+
+    ev.events = 0;
+    if (c->pendlen == 0 && !c->closing)
+        ev.events |= EPOLLIN;
+    if (c->pendlen > 0)
+        ev.events |= EPOLLOUT;
+    if (ev.events == c->watching)
+        return;
+    ev.data.ptr = c;
+    epoll_ctl(c->sh->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->watching = ev.events;
+}
+
+static void conn_close(struct conn *c)
+{
+    epoll_ctl(c->sh->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    adv_session_free(&c->s);
+    free(c->pending);
+    free(c->unread);
+    free(c);
+    atomic_fetch_sub(&nconns, 1);
+}
+
+/* Send LEN bytes at BUF to C, after anything still pending; what the
+   socket does not take now is kept for later. -1 if C is gone. */
+static int conn_send(struct conn *c, const char *buf, size_t len)
+{
+    ssize_t n = 0;
+
+    if (c->pendlen == 0) {
+        n = send(c->fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                return -1;
+            n = 0;
+        }
+        if ((size_t)n == len)
+            return 0;
+    }
+    if (c->pendpos > 0) {
+        memmove(c->pending, c->pending + c->pendpos, c->pendlen - c->pendpos);
+        c->pendlen -= c->pendpos;
+        c->pendpos = 0;
+    }
+    c->pending = xrealloc(c->pending, c->pendlen + len - (size_t)n);
+    memcpy(c->pending + c->pendlen, buf + n, len - (size_t)n);
+    c->pendlen += len - (size_t)n;
+    return 0;
+}
+
+/* Send what is pending for C. -1 if C is gone. */
+static int conn_flush(struct conn *c)
+{
+    while (c->pendpos < c->pendlen) {
+        ssize_t n = send(c->fd, c->pending + c->pendpos, c->pendlen - c->pendpos,
+                         MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        c->pendpos += (size_t)n;
+    }
+    free(c->pending);
+    c->pending = NULL;
+    c->pendlen = c->pendpos = 0;
+    return 0;
+}
+
+/* Send the output of C's last turn, newlines as CR LF, and give back
+   the session's output arena. -1 if C is gone. */
+static int conn_turn_output(struct conn *c)
+{
+    struct shard *sh = c->sh;
+    size_t len, i, n = 0;
+    const char *out = adv_output(&c->s, &len);
+    int r;
+
+    if (sh->netcap < 2 * len) {
+        sh->netcap = 2 * len;
+        sh->netbuf = xrealloc(sh->netbuf, sh->netcap);
+    }
+    for (i = 0; i < len; ++i) {
+        if (out[i] == '\n')
+            sh->netbuf[n++] = '\r';
+        sh->netbuf[n++] = out[i];
+    }
+    adv_session_free(&c->s);
+    r = conn_send(c, sh->netbuf, n);
+    if (c->s.prompt == ADV_PROMPT_OVER)
+        c->closing = 1;
+    return r;
+}
+
+/* Take the bytes at BUF that C sent: drop telnet commands, play each
+   complete line. Once a turn's output is left pending, the rest is kept
+   in c->unread for when it has gone. -1 if C is gone. */
+static int conn_input(struct conn *c, const unsigned char *buf, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len && !c->closing && c->pendlen == 0; ++i) {
+        unsigned char ch = buf[i];
+
+        switch (c->tn) {
+        case TN_DATA:
+            if (ch == IAC) {
+                c->tn = TN_IAC;
+                continue;
+            }
+            break;
+        case TN_IAC:
+            c->tn = ch == SB ? TN_SB : ch >= WILL && ch < IAC ? TN_OPTION : TN_DATA;
+            if (ch != IAC)
+                continue;
+            break;              /* IAC IAC: a literal 255 */
+        case TN_OPTION:
+            c->tn = TN_DATA;
+            continue;
+        case TN_SB:
+            if (ch == IAC)
+                c->tn = TN_SB_IAC;
+            continue;
+        case TN_SB_IAC:
+            c->tn = ch == SE ? TN_DATA : TN_SB;
+            continue;
+        }
+        if (ch == '\n') {
+            c->line[c->linelen] = '\0';
+            c->linelen = 0;
+            adv_step(&c->s, c->line);
+            if (conn_turn_output(c) != 0)
+                return -1;
+        } else if (ch != '\r' && ch != '\0' && c->linelen < LINE_SIZE - 1) {
+            c->line[c->linelen++] = (char)ch;
+        }
+    }
+    if (i < len && !c->closing) {
+        c->unread = xrealloc(NULL, len - i);
+        memcpy(c->unread, buf + i, len - i);
+        c->unreadlen = len - i;
+    }
+    return 0;
+}
+
+/* Take the input C sent while its output was pending. -1 if C is gone. */
+static int conn_unread(struct conn *c)
+{
+    unsigned char *buf = c->unread;
+    size_t len = c->unreadlen;
+    int r;
+
+    c->unread = NULL;
+    c->unreadlen = 0;
+    r = conn_input(c, buf, len);
+    free(buf);
+    return r;
+}
+
+/* Start game ID on the connection FD, which has come to SH. */
+static void conn_open(struct shard *sh, int fd, uint64_t id)
+{
+    struct epoll_event ev;
+    struct conn *c;
+    int one = 1;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    c = xrealloc(NULL, sizeof(*c));
+    memset(c, 0, sizeof(*c));
+    c->sh = sh;
+    c->fd = fd;
+    adv_session_init(&c->s, world);
+    adv_session_seed(&c->s, adv_ran_split(seed, id));
+    ev.events = c->watching = EPOLLIN;
+    ev.data.ptr = c;
+    if (epoll_ctl(sh->epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        close(fd);
+        free(c);
+        atomic_fetch_sub(&nconns, 1);
+        return;
+    }
+
+    adv_step(&c->s, NULL);
+    if (conn_send(c, banner, sizeof(banner) - 1) != 0 || conn_turn_output(c) != 0)
+        conn_close(c);
+    else
+        conn_watch(c);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Shards                                                                    */
+/* ------------------------------------------------------------------------- */
+
+/* Give connection ID on FD to its shard, waiting while the shard's queue
+   is full. Only the listener calls this. */
+static void shard_hand(int fd, uint64_t id)
+{
+    struct shard *sh = &shards[id % (uint64_t)nshards];
+    size_t tail = atomic_load_explicit(&sh->tail, memory_order_relaxed);
+    uint64_t one = 1;
+
+    while (tail - atomic_load_explicit(&sh->head, memory_order_acquire) == QUEUE_SIZE)
+        sched_yield();
+    sh->queue[tail % QUEUE_SIZE].fd = fd;
+    sh->queue[tail % QUEUE_SIZE].id = id;
+    atomic_store_explicit(&sh->tail, tail + 1, memory_order_release);
+    if (write(sh->wakefd, &one, sizeof(one)) < 0)
+        perror("serve: eventfd");
+}
+
+/* Open the connections waiting in SH's queue. */
+static void shard_take(struct shard *sh)
+{
+    size_t head = atomic_load_explicit(&sh->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&sh->tail, memory_order_acquire);
+    uint64_t count;
+
+    if (read(sh->wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        perror("serve: eventfd");
+    for (; head != tail; ++head) {
+        struct handoff h = sh->queue[head % QUEUE_SIZE];
+        atomic_store_explicit(&sh->head, head + 1, memory_order_release);
+        conn_open(sh, h.fd, h.id);
+    }
+}
+
+static void *shard_loop(void *arg)
+{
+    static _Thread_local unsigned char buf[4096];
+    static _Thread_local struct epoll_event events[EVENTS];
+    struct shard *sh = arg;
+    int i, n;
+
+    for (;;) {
+        n = epoll_wait(sh->epfd, events, EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("serve: epoll_wait");
+            exit(EXIT_FAILURE);
+        }
+        for (i = 0; i < n; ++i) {
+            struct conn *c = events[i].data.ptr;
+            int gone = 0;
+
+            if (!c) {
+                shard_take(sh);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT)
+                gone = conn_flush(c) != 0;
+            if (!gone && c->pendlen == 0 && c->unreadlen > 0)
+                gone = conn_unread(c) != 0;
+            if (!gone && c->pendlen == 0
+                && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                ssize_t got = recv(c->fd, buf, sizeof(buf), 0);
+                if (got > 0)
+                    gone = conn_input(c, buf, (size_t)got) != 0;
+                else if (got == 0 || (errno != EAGAIN && errno != EINTR))
+                    gone = 1;
+            }
+            if (gone || (c->closing && c->pendlen == 0))
+                conn_close(c);
+            else
+                conn_watch(c);
+        }
+    }
+    return NULL;
+}
+
+static int shard_start(struct shard *sh)
+{
+    struct epoll_event ev;
+
+    sh->epfd = epoll_create1(0);
+    sh->wakefd = eventfd(0, EFD_NONBLOCK);
+    if (sh->epfd < 0 || sh->wakefd < 0) {
+        perror("serve: epoll_create1/eventfd");
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;         /* NULL: the queue */
+    if (epoll_ctl(sh->epfd, EPOLL_CTL_ADD, sh->wakefd, &ev) != 0
+        || pthread_create(&sh->thread, NULL, shard_loop, sh) != 0) {
+        fprintf(stderr, "serve: cannot start shards\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    static const struct timespec busy = { 0, 10000000 };
+    const char *world_path = NULL;
+    struct sockaddr_in addr;
+    struct rlimit rl;
+    int port = 4000, one = 1;
+    int listenfd, fd, i;
+    uint64_t games = 0;
+
+    seed = (uint64_t)time(NULL);
+    nshards = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-max") == 0 && i + 1 < argc) {
+            max_conns = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            nshards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-world") == 0 && i + 1 < argc) {
+            world_path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-port N] [-seed N] [-max N] [-threads N] [-world FILE]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nshards < 1)
+        nshards = 1;
+    if (nshards > MAX_SHARDS)
+        nshards = MAX_SHARDS;
+    if (world_path) {
+        world = adv_world_map_image(world_path);
+        if (!world)
+            return EXIT_FAILURE;
+    } else {
+        world = adv_world_default();
+    }
+
+    /* a descriptor for every connection if the system allows it */
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenfd < 0) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listenfd, (struct sockaddr *)&addr, sizeof(addr)) != 0
+        || listen(listenfd, SOMAXCONN) != 0) {
+        perror("bind");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < nshards; ++i)
+        if (shard_start(&shards[i]) != 0)
+            return EXIT_FAILURE;
+    fprintf(stderr, "serve: listening on port %d, %d shards\n", port, nshards);
+
+    for (;;) {
+        fd = accept(listenfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE)
+                nanosleep(&busy, NULL);     /* until a connection closes */
+            else if (errno != EINTR && errno != ECONNABORTED)
+                perror("accept");
+            continue;
+        }
+        if (atomic_load(&nconns) >= max_conns) {
+            close(fd);
+            continue;
+        }
+        atomic_fetch_add(&nconns, 1);
+        shard_hand(fd, games++);
+    }
+}
@@ -0,0 +1,307 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    servebench: how many commands a second serve plays.
+
+    Opens many connections to a running serve, answers the start of each
+    game (G, then NO to the instructions), and then has every connection
+    play a script of commands over and over, sending the next command as
+    soon as the reply to the last has come, for a set time. With one
+    command in flight per connection the server is kept busy as long as
+    there are enough connections, and the commands a second it gets
+    through is the number to compare across serve -threads. The clients
+    run on threads of their own, each with its own epoll loop; run it on
+    other CPUs than the server (taskset) for numbers that mean anything.
+
+        cc -std=c11 -O2 -pthread servebench.c -o servebench
+        ./serve -port 4000 -threads 4 &
+        ./servebench -port 4000 -conns 2000 -secs 10
+
+    The default script walks in and out of the building, taking and
+    dropping the lamp, where the dwarves never come. A reply is taken to
+    be what one read gets, which holds for replies on the loopback.
+    Options: -port N (default 4000), -conns N (default 1000), -threads N
+    (client threads, default 1), -secs N (default 10), -script FILE (one
+    command to a line).
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 256
+#define MAX_SCRIPT 256
+#define EVENTS 256
+
+static const char *default_script[] = {
+    "ENTER\r\n", "TAKE LAMP\r\n", "DROP LAMP\r\n", "OUT\r\n"
+};
+
+static char *script[MAX_SCRIPT];
+static size_t script_len[MAX_SCRIPT];
+static int nscript;
+
+static int port = 4000;
+static int nconns = 1000;
+static atomic_int ready;        /* threads whose games have started */
+static atomic_int timing, stop;
+
+struct bench_conn {
+    int fd;
+    int next;                   /* script line to send next */
+};
+
+struct worker {
+    pthread_t thread;
+    int count;                  /* its connections */
+    unsigned long commands;     /* replies got while timing */
+    int failed;
+};
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Read one reply on FD, waiting for it unless FLAGS has MSG_DONTWAIT.
+   -1 if there is none. */
+static int read_reply(int fd, int flags)
+{
+    static _Thread_local char buf[65536];
+    ssize_t n;
+
+    do
+        n = recv(fd, buf, sizeof(buf), flags);
+    while (n < 0 && errno == EINTR);
+    return n > 0 ? 0 : -1;
+}
+
+static void *worker(void *arg)
+{
+    static _Thread_local struct epoll_event events[EVENTS];
+    struct worker *w = arg;
+    struct bench_conn *conns = calloc((size_t)w->count, sizeof(*conns));
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    struct timespec settle = { 0, 100000000 };
+    int epfd = epoll_create1(0);
+    int i, n, one = 1;
+
+    if (!conns || epfd < 0) {
+        w->failed = 1;
+        atomic_fetch_add(&ready, 1);
+        return NULL;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+
+    /* connect, and answer the start of every game */
+    for (i = 0; i < w->count; ++i) {
+        struct bench_conn *c = &conns[i];
+
+        c->fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (c->fd < 0 || connect(c->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            perror("servebench: connect");
+            w->failed = 1;
+            atomic_fetch_add(&ready, 1);
+            return NULL;
+        }
+        setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    for (i = 0; i < w->count; ++i)
+        if (read_reply(conns[i].fd, 0) != 0)
+            goto gone;
+    nanosleep(&settle, NULL);
+    for (i = 0; i < w->count; ++i)      /* the banner can come on its own */
+        read_reply(conns[i].fd, MSG_DONTWAIT);
+    for (i = 0; i < w->count; ++i)
+        if (send_all(conns[i].fd, "G\r\n", 3) != 0)
+            goto gone;
+    for (i = 0; i < w->count; ++i)
+        if (read_reply(conns[i].fd, 0) != 0 || send_all(conns[i].fd, "NO\r\n", 4) != 0)
+            goto gone;
+    for (i = 0; i < w->count; ++i) {
+        struct bench_conn *c = &conns[i];
+
+        if (read_reply(c->fd, 0) != 0)
+            goto gone;
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+    atomic_fetch_add(&ready, 1);
+
+    /* the first command on every connection, then one per reply */
+    for (i = 0; i < w->count; ++i) {
+        struct bench_conn *c = &conns[i];
+        if (send_all(c->fd, script[0], script_len[0]) != 0)
+            goto gone;
+        c->next = 1 % nscript;
+    }
+    while (!atomic_load(&stop)) {
+        n = epoll_wait(epfd, events, EVENTS, 100);
+        for (i = 0; i < n; ++i) {
+            struct bench_conn *c = events[i].data.ptr;
+
+            if (read_reply(c->fd, 0) != 0
+                || send_all(c->fd, script[c->next], script_len[c->next]) != 0)
+                goto gone;
+            c->next = (c->next + 1) % nscript;
+            if (atomic_load_explicit(&timing, memory_order_relaxed))
+                ++w->commands;
+        }
+    }
+    for (i = 0; i < w->count; ++i)
+        close(conns[i].fd);
+    free(conns);
+    close(epfd);
+    return NULL;
+
+gone:
+    fprintf(stderr, "servebench: the server closed a connection\n");
+    w->failed = 1;
+    atomic_store(&stop, 1);
+    atomic_fetch_add(&ready, 1);
+    return NULL;
+}
+
+static int read_script(const char *path)
+{
+    char line[256];
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (nscript < MAX_SCRIPT && fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        script_len[nscript] = strlen(line) + 2;
+        script[nscript] = malloc(script_len[nscript] + 1);
+        if (!script[nscript]) {
+            fclose(f);
+            return -1;
+        }
+        sprintf(script[nscript++], "%s\r\n", line);
+    }
+    fclose(f);
+    if (nscript == 0) {
+        fprintf(stderr, "%s: no commands\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static struct worker workers[MAX_THREADS];
+    const char *script_path = NULL;
+    struct timespec sleep_for, tick = { 0, 10000000 };
+    struct rlimit rl;
+    unsigned long total = 0;
+    int nthreads = 1, secs = 10, failed = 0;
+    int i, t;
+    double t0, elapsed;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-port") == 0 && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-conns") == 0 && i + 1 < argc) {
+            nconns = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-secs") == 0 && i + 1 < argc) {
+            secs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-script") == 0 && i + 1 < argc) {
+            script_path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-port N] [-conns N] [-threads N] [-secs N] [-script FILE]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nconns < 1)
+        nconns = 1;
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    if (nthreads > nconns)
+        nthreads = nconns;
+    if (script_path) {
+        if (read_script(script_path) != 0)
+            return EXIT_FAILURE;
+    } else {
+        for (nscript = 0; nscript < (int)(sizeof(default_script) / sizeof(default_script[0])); ++nscript) {
+            script[nscript] = (char *)default_script[nscript];
+            script_len[nscript] = strlen(default_script[nscript]);
+        }
+    }
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    for (t = 0; t < nthreads; ++t) {
+        workers[t].count = (int)((long)nconns * (t + 1) / nthreads - (long)nconns * t / nthreads);
+        if (pthread_create(&workers[t].thread, NULL, worker, &workers[t]) != 0) {
+            fprintf(stderr, "servebench: cannot start threads\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* time from when every game has started */
+    while (atomic_load(&ready) < nthreads)
+        nanosleep(&tick, NULL);
+    atomic_store(&timing, 1);
+    t0 = now();
+    sleep_for.tv_sec = secs;
+    sleep_for.tv_nsec = 0;
+    while (!atomic_load(&stop) && nanosleep(&sleep_for, &sleep_for) != 0)
+        ;
+    atomic_store(&stop, 1);
+    elapsed = now() - t0;
+    for (t = 0; t < nthreads; ++t) {
+        pthread_join(workers[t].thread, NULL);
+        total += workers[t].commands;
+        failed |= workers[t].failed;
+    }
+    if (failed)
+        return EXIT_FAILURE;
+
+    printf("%d connections, %d threads: %lu commands in %.2f s, %.0f commands/s, %.3f ms a reply\n",
+           nconns, nthreads, total, elapsed, total / elapsed, nconns / (total / elapsed) * 1000);
+    return 0;
+}
@@ -0,0 +1,485 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    solve: the fewest commands that bring the game to a goal.
+
+    An iterative-deepening A* search (IDA*) over the game itself: each
+    state is a session, each move a command of the vocabulary
+    (adv_world_commands()) stepped on a fork of it. A state is cut off when
+    the commands left cannot reach the goal even along the shortest way
+    through the cave, measured on the room graph of adv_world_adjacent(),
+    so the search stays close to the route the answer takes. States already
+    shown not to reach the goal in as many commands are remembered by
+    adv_session_hash() and not searched again.
+
+    By default the random numbers come from the stream with a fixed seed,
+    so the answer is a list of commands to replay. With -adversarial every
+    random event goes whichever way is worst (adv_session_chance()), and
+    the answer is a plan that reaches the goal whatever happens, which
+    branches where a random event changes what to do next.
+
+        cc -std=c99 -O2 -DADVENT_NO_MAIN advent.c solve.c -o solve
+        ./solve -goal hold=NUGGET
+        ./solve -adversarial -goal prop=GRATE:1
+
+    Options: -goal SPEC (see adv_goal_parse() in advent.h), -seed N
+    (default 1), -adversarial, -depth N (most commands tried, default 40),
+    -script FILE (commands played first; the search starts where they
+    leave the game), -world FILE (a world image).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "advent.h"
+
+#define MAX_COMMANDS 1024
+#define MAX_DEPTH 64
+#define FAR 1000                /* distance to a room that cannot be reached */
+#define TABLE_BITS 22
+
+/* ------------------------------------------------------------------------- */
+/* Search                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static const struct adv_world *world;
+static struct adv_goal goal;
+static char commands[MAX_COMMANDS + 2][ADV_COMMAND_SIZE];
+static int ncommands;           /* then "YES" and "NO" */
+static int adversarial;
+
+/* dist[a][b]: the fewest moves from room A to room B; restart_dist[a]:
+   the fewest from room A to starting the game over */
+static short dist[301][301];
+static short restart_dist[301];
+
+/* the session of each level of the search, and its random outcomes */
+static struct adv_session level[MAX_DEPTH + 1];
+static struct adv_chance_path paths[MAX_DEPTH + 1];
+static uint16_t events[MAX_DEPTH + 1][1024];
+static unsigned long expanded;
+
+/* States known not to reach the goal: for each key, the most commands
+   with which it was searched in vain. */
+static struct failed {
+    uint64_t key;
+    int budget;
+} *table;
+
+/* The key of the state S is in: adv_session_key(), and with a fixed seed
+   how far along the stream it is, as that decides what happens next too. */
+static uint64_t state_key(const struct adv_session *s)
+{
+    uint64_t key = adv_session_key(s);
+
+    if (!adversarial)
+        key ^= adv_mix64(s->ran_count + 0x9E3779B97F4A7C15ULL);
+    return key;
+}
+
+static struct failed *table_slot(uint64_t key)
+{
+    size_t mask = ((size_t)1 << TABLE_BITS) - 1;
+    size_t i = (size_t)adv_mix64(key) & mask;
+    struct failed *low = &table[i];
+    int k;
+
+    /* the key's own slot, else an empty one, else the least useful of 4 */
+    for (k = 0; k < 4; ++k, i = (i + 1) & mask) {
+        if (table[i].key == key || table[i].budget == 0)
+            return &table[i];
+        if (table[i].budget < low->budget)
+            low = &table[i];
+    }
+    return low;
+}
+
+/* Whether some motion from room LOC starts the game over. */
+static int restarts(int loc)
+{
+    int k;
+
+    for (k = 1; k < 1000; ++k)
+        if (adv_world_exit(world, loc, k) == 306)
+            return 1;
+    return 0;
+}
+
+/* Compute dist[][] by a breadth-first search from every room, over the
+   exits of adv_world_adjacent() and their reverses (BACK), and between
+   rooms 1 and 0 (BACK before the first move goes to room 0); then
+   restart_dist[]. */
+static void room_graph(void)
+{
+    static int adj[301][602];
+    static int nadj[301];
+    int queue[301];
+    char restart[301];
+    int a, b, i, n;
+
+    for (a = 1; a <= 300; ++a) {
+        int rooms[301];
+        n = adv_world_adjacent(world, a, rooms, 301);
+        for (i = 0; i < n && i < 301; ++i) {
+            b = rooms[i];
+            adj[a][nadj[a]++] = b;
+            adj[b][nadj[b]++] = a;
+        }
+    }
+    adj[0][nadj[0]++] = 1;
+    adj[1][nadj[1]++] = 0;
+
+    for (a = 0; a <= 300; ++a) {
+        int head = 0, tail = 0;
+
+        for (b = 0; b <= 300; ++b)
+            dist[a][b] = FAR;
+        dist[a][a] = 0;
+        queue[tail++] = a;
+        while (head < tail) {
+            int r = queue[head++];
+            for (i = 0; i < nadj[r]; ++i) {
+                b = adj[r][i];
+                if (dist[a][b] == FAR) {
+                    dist[a][b] = (short)(dist[a][r] + 1);
+                    queue[tail++] = b;
+                }
+            }
+        }
+    }
+
+    for (b = 0; b <= 300; ++b)
+        restart[b] = (char)restarts(b);
+    for (a = 0; a <= 300; ++a) {
+        restart_dist[a] = FAR;
+        for (b = 1; b <= 300; ++b)
+            if (restart[b] && dist[a][b] + 1 < restart_dist[a])
+                restart_dist[a] = (short)(dist[a][b] + 1);
+    }
+}
+
+static int room_dist(int a, int b)
+{
+    if (a < 0 || a > 300 || b < 0 || b > 300)
+        return FAR;
+    return dist[a][b];
+}
+
+/* A lower bound on the commands from room LOC to term WHAT of the goal
+   ('h' or 'o', with value VAL) for an object at AT. Only the player
+   moves objects from room to room, one move at a time, so an object in
+   another room takes the walk there and a TAKE at least. */
+static int object_bound(int what, int loc, int at, int val)
+{
+    if (what == 'h') {
+        if (at > 0 && at < 300)
+            return room_dist(loc, at) + 1;
+        return at != -1;
+    }
+    if (at == val)
+        return 0;
+    if (at == -1)
+        return room_dist(loc, val) + 1;
+    if (at > 0 && at < 300)
+        return room_dist(loc, at) + room_dist(at, val) + 2;
+    return 1;
+}
+
+/* A lower bound on the commands from S to the goal: the largest over its
+   terms. Starting over (306) puts every object back where it began, so
+   for an object the bound is also no more than the way to a restart and
+   on from there. */
+static int heuristic(const struct adv_session *s)
+{
+    const struct adv_game *g = &s->g;
+    int h = 0, i;
+
+    for (i = 0; i < goal.n; ++i) {
+        int what = goal.term[i].what;
+        int obj = goal.term[i].obj, val = goal.term[i].val;
+        int t = 0;
+
+        switch (what) {
+        case 'r':
+            t = room_dist(g->loc, val);
+            break;
+        case 'p':
+            t = g->prop[obj] != val;
+            break;
+        case 'h':
+        case 'o':
+            t = object_bound(what, g->loc, g->iplace[obj], val);
+            if (g->loc >= 0 && g->loc <= 300 && restart_dist[g->loc] < t) {
+                int r = restart_dist[g->loc]
+                      + object_bound(what, 1, world->start.iplace[obj], val);
+                if (r < t)
+                    t = r;
+            }
+            break;
+        }
+        if (t > h)
+            h = t;
+    }
+    return h;
+}
+
+/* Step level D + 1 to the outcome of command C from level D that
+   paths[D] says. */
+static void play(int d, int c)
+{
+    adv_session_fork(&level[d + 1], &level[d]);
+    if (adversarial)
+        adv_session_chance(&level[d + 1], adv_chance_path_take, &paths[d]);
+    adv_step(&level[d + 1], commands[c]);
+}
+
+/* The commands that can be given in state S. */
+static void command_range(const struct adv_session *s, int *first, int *last)
+{
+    *first = s->prompt == ADV_PROMPT_YES ? ncommands : 0;
+    *last = s->prompt == ADV_PROMPT_YES ? ncommands + 2
+          : s->prompt == ADV_PROMPT_COMMAND ? ncommands : 0;
+}
+
+/* What command C does from level D: a hash of the keys of all the states
+   it can lead to, or 0 if one of them is the state it started from. A
+   move that can leave the state as it was is never needed: if the state
+   can reach the goal in one command less, it has another first move that
+   does. Leaves level D + 1 at the last outcome, and *OUTCOMES at how many
+   there are. */
+static uint64_t command_effect(int d, int c, uint64_t key, int *outcomes)
+{
+    uint64_t effect = 0, k;
+
+    *outcomes = 0;
+    adv_chance_path_start(&paths[d]);
+    do {
+        play(d, c);
+        k = state_key(&level[d + 1]);
+        if (k == key)
+            return 0;
+        effect = adv_mix64(effect ^ k) | 1;
+        ++*outcomes;
+    } while (adversarial && adv_chance_path_next(&paths[d]));
+    return effect;
+}
+
+/* Whether the state at level D reaches the goal within BUDGET commands,
+   whatever the random events do with -adversarial. Returns the command
+   to give plus one, -1 if the goal is already met, or 0 if there is
+   none. Most commands do the same as some other (nothing, or only what
+   happens at every turn), so each different effect is searched once. */
+static int search(int d, int budget)
+{
+    static uint64_t tried[MAX_DEPTH + 1][MAX_COMMANDS + 2];
+    const struct adv_session *s = &level[d];
+    struct failed *f;
+    uint64_t key, effect;
+    int c, i, first, last, ntried = 0, outcomes;
+
+    if (adv_goal_met(&goal, s))
+        return -1;
+    if (budget == 0 || d == MAX_DEPTH || heuristic(s) > budget)
+        return 0;
+    key = state_key(s);
+    f = table_slot(key);
+    if (f->key == key && f->budget >= budget)
+        return 0;
+
+    ++expanded;
+    command_range(s, &first, &last);
+    for (c = first; c < last; ++c) {
+        int ok = 1;
+
+        effect = command_effect(d, c, key, &outcomes);
+        if (effect == 0)
+            continue;
+        for (i = 0; i < ntried && tried[d][i] != effect; ++i)
+            ;
+        if (i < ntried)
+            continue;
+        tried[d][ntried++] = effect;
+
+        if (outcomes == 1) {
+            ok = search(d + 1, budget - 1) != 0;
+        } else {
+            adv_chance_path_start(&paths[d]);
+            do {
+                play(d, c);
+                if (!search(d + 1, budget - 1)) {
+                    ok = 0;
+                    break;
+                }
+            } while (adv_chance_path_next(&paths[d]));
+        }
+        if (ok)
+            return c + 1;
+    }
+
+    f = table_slot(key);
+    f->key = key;
+    f->budget = budget;
+    return 0;
+}
+
+/* Print the plan for the state at level D, found reaching the goal
+   within BUDGET commands: the command for each state, and where random
+   events lead to different states, the plan for each of them. */
+static void print_plan(int d, int budget, int indent)
+{
+    struct adv_chance_path outcome[64];
+    uint64_t key[64];
+    int n = 0, c, i, k;
+
+    c = search(d, budget);
+    if (c < 0) {
+        printf("%*s(goal)\n", indent, "");
+        return;
+    }
+    --c;
+    printf("%*s%s\n", indent, "", commands[c]);
+
+    /* the distinct states the command can lead to */
+    adv_chance_path_start(&paths[d]);
+    do {
+        uint64_t kk;
+        play(d, c);
+        kk = state_key(&level[d + 1]);
+        for (i = 0; i < n && key[i] != kk; ++i)
+            ;
+        if (i == n && n < 64) {
+            key[n] = kk;
+            outcome[n++] = paths[d];
+        }
+    } while (adversarial && adv_chance_path_next(&paths[d]));
+
+    for (i = 0; i < n; ++i) {
+        if (n > 1) {
+            printf("%*s  random:", indent, "");
+            for (k = 0; k < outcome[i].len; ++k)
+                printf(" %s", (outcome[i].bits >> k) & 1 ? "yes" : "no");
+            printf("\n");
+        }
+        paths[d] = outcome[i];
+        paths[d].len = 0;
+        play(d, c);
+        print_plan(d + 1, budget - 1, n > 1 ? indent + 4 : indent);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* main()                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static double now(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* Play the commands in the file at PATH, one to a line, on S. */
+static int play_script(struct adv_session *s, const char *path)
+{
+    char line[256];
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) && s->prompt != ADV_PROMPT_OVER) {
+        line[strcspn(line, "\r\n")] = '\0';
+        adv_step(s, line);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *world_path = NULL;
+    const char *goal_spec = NULL;
+    const char *script = NULL;
+    unsigned long long seed = 1;
+    int max_depth = 40;
+    int budget, found = 0, i;
+    double t0;
+
+    for (i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-goal") == 0 && i + 1 < argc) {
+            goal_spec = argv[++i];
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-adversarial") == 0) {
+            adversarial = 1;
+        } else if (strcmp(argv[i], "-depth") == 0 && i + 1 < argc) {
+            max_depth = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-script") == 0 && i + 1 < argc) {
+            script = argv[++i];
+        } else if (strcmp(argv[i], "-world") == 0 && i + 1 < argc) {
+            world_path = argv[++i];
+        } else {
+            goal_spec = NULL;
+            break;
+        }
+    }
+    if (!goal_spec) {
+        fprintf(stderr, "usage: %s -goal SPEC [-seed N] [-adversarial] [-depth N] [-script FILE] [-world FILE]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (max_depth < 0 || max_depth > MAX_DEPTH) {
+        fprintf(stderr, "solve: -depth must be 0..%d\n", MAX_DEPTH);
+        return EXIT_FAILURE;
+    }
+    if (world_path) {
+        world = adv_world_map_image(world_path);
+        if (!world)
+            return EXIT_FAILURE;
+    } else {
+        world = adv_world_default();
+    }
+    if (adv_goal_parse(&goal, world, goal_spec) != 0)
+        return EXIT_FAILURE;
+    ncommands = adv_world_commands(world, commands, MAX_COMMANDS);
+    if (ncommands > MAX_COMMANDS)
+        ncommands = MAX_COMMANDS;
+    strcpy(commands[ncommands], "YES");
+    strcpy(commands[ncommands + 1], "NO");
+    room_graph();
+    table = calloc((size_t)1 << TABLE_BITS, sizeof(*table));
+    if (!table) {
+        fprintf(stderr, "solve: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i <= MAX_DEPTH; ++i) {
+        adv_session_init(&level[i], world);
+        adv_session_headless(&level[i], events[i], sizeof(events[i]) / sizeof(events[i][0]));
+    }
+    adv_session_seed(&level[0], seed);
+    adv_step(&level[0], "");
+    if (script && play_script(&level[0], script) != 0)
+        return EXIT_FAILURE;
+
+    t0 = now();
+    for (budget = 0; budget <= max_depth; ++budget) {
+        found = search(0, budget) != 0;
+        printf("%2d commands: %10lu states searched, %.2f s\n",
+               budget, expanded, now() - t0);
+        fflush(stdout);
+        if (found)
+            break;
+    }
+    if (!found) {
+        printf("goal not reached in %d commands\n", max_depth);
+        return EXIT_FAILURE;
+    }
+    if (adversarial)
+        printf("goal reached in %d commands whatever happens:\n", budget);
+    else
+        printf("goal reached in %d commands with seed %llu:\n", budget, seed);
+    print_plan(0, budget, 4);
+    return 0;
+}
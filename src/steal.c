@@ -0,0 +1,155 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    Work stealing for batch jobs over many games: see steal.h.
+
+    The deques are Chase and Lev's, with the C11 orderings of Le, Pop,
+    Cohen and Zappa Nardelli ("Correct and Efficient Work-Stealing for
+    Weak Memory Models", 2013), over a fixed array: a deque only ever
+    holds halves of ranges, each smaller than the one above it, so it
+    never needs more than one slot per bit of a task number.
+*/
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "steal.h"
+
+#define DEQUE_SIZE 128          /* ranges a deque can hold */
+
+/* Ranges of tasks lo..hi-1. The owner pushes and takes at the bottom;
+   thieves take from the top. */
+struct steal_deque {
+    _Alignas(64) _Atomic int64_t top;
+    _Alignas(64) _Atomic int64_t bottom;
+    _Atomic uint64_t lo[DEQUE_SIZE], hi[DEQUE_SIZE];
+    int victim;                 /* the next deque the owner steals from */
+};
+
+static void deque_push(struct steal_deque *d, uint64_t lo, uint64_t hi)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+
+    if (b - t >= DEQUE_SIZE) {
+        fprintf(stderr, "steal: deque overflow\n");
+        exit(EXIT_FAILURE);
+    }
+    atomic_store_explicit(&d->lo[b % DEQUE_SIZE], lo, memory_order_relaxed);
+    atomic_store_explicit(&d->hi[b % DEQUE_SIZE], hi, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+/* Take the bottom range of D, the owner's. 0 if D is empty. */
+static int deque_take(struct steal_deque *d, uint64_t *lo, uint64_t *hi)
+{
+    int64_t b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    int64_t t;
+    int got = 1;
+
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+    *lo = atomic_load_explicit(&d->lo[b % DEQUE_SIZE], memory_order_relaxed);
+    *hi = atomic_load_explicit(&d->hi[b % DEQUE_SIZE], memory_order_relaxed);
+    if (t == b) {
+        /* the last range: a thief may be after it too */
+        got = atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                      memory_order_seq_cst,
+                                                      memory_order_relaxed);
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return got;
+}
+
+/* Steal the top range of D, another worker's. 0 if D is empty or
+   another thief got it first. */
+static int deque_steal(struct steal_deque *d, uint64_t *lo, uint64_t *hi)
+{
+    int64_t t = atomic_load_explicit(&d->top, memory_order_acquire);
+    int64_t b;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b)
+        return 0;
+    *lo = atomic_load_explicit(&d->lo[t % DEQUE_SIZE], memory_order_relaxed);
+    *hi = atomic_load_explicit(&d->hi[t % DEQUE_SIZE], memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                                                   memory_order_seq_cst,
+                                                   memory_order_relaxed);
+}
+
+int steal_init(struct steal_pool *pool, uint64_t ntasks, int nworkers)
+{
+    size_t size = (size_t)nworkers * sizeof(struct steal_deque);
+    int w;
+
+    pool->deques = aligned_alloc(64, size);
+    if (!pool->deques) {
+        fprintf(stderr, "steal: out of memory\n");
+        return -1;
+    }
+    memset(pool->deques, 0, size);
+    pool->nworkers = nworkers;
+    atomic_init(&pool->left, ntasks);
+    for (w = 0; w < nworkers; ++w) {
+        uint64_t lo = ntasks / (uint64_t)nworkers * (uint64_t)w
+            + ntasks % (uint64_t)nworkers * (uint64_t)w / (uint64_t)nworkers;
+        uint64_t hi = ntasks / (uint64_t)nworkers * (uint64_t)(w + 1)
+            + ntasks % (uint64_t)nworkers * (uint64_t)(w + 1) / (uint64_t)nworkers;
+
+        pool->deques[w].victim = (w + 1) % nworkers;
+        if (lo < hi)
+            deque_push(&pool->deques[w], lo, hi);
+    }
+    return 0;
+}
+
+void steal_free(struct steal_pool *pool)
+{
+    free(pool->deques);
+    pool->deques = NULL;
+}
+
+int64_t steal_next(struct steal_pool *pool, int w)
+{
+    struct steal_deque *d = &pool->deques[w];
+    uint64_t lo, hi;
+    int i;
+
+    for (;;) {
+        int got = deque_take(d, &lo, &hi);
+
+        /* go round the others once, from where the last steal was */
+        for (i = 1; !got && i < pool->nworkers; ++i) {
+            if (d->victim == w)
+                d->victim = (d->victim + 1) % pool->nworkers;
+            got = deque_steal(&pool->deques[d->victim], &lo, &hi);
+            if (!got)
+                d->victim = (d->victim + 1) % pool->nworkers;
+        }
+        if (got) {
+            /* keep the first task, leave the rest for stealing in halves,
+               the largest on top */
+            while (hi - lo > 1) {
+                uint64_t mid = lo + (hi - lo) / 2;
+                deque_push(d, mid, hi);
+                hi = mid;
+            }
+            atomic_fetch_sub(&pool->left, 1);
+            return (int64_t)lo;
+        }
+        /* the rest may be in a range another worker is splitting */
+        if (atomic_load(&pool->left) == 0)
+            return -1;
+        sched_yield();
+    }
+}
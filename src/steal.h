@@ -0,0 +1,48 @@
+/*
+    Colossal Cave Adventure - pure C port
+
+    Work stealing for batch jobs over many games (steal.c).
+
+    A pool hands out the tasks 0..N-1 of a job to a fixed set of worker
+    threads, for jobs whose tasks take very different times: a game that
+    is killed in its first turns against one that wanders the maze for
+    thousands. Each worker has its own deque (Chase-Lev) of ranges of
+    tasks. A worker takes from the bottom of its own, splitting a range in
+    halves as it goes, and a worker whose deque is empty steals from the
+    top of another's, where the largest ranges are. Work moves only when a
+    worker would otherwise be idle, so a few long games no longer hold up
+    the end of a job on one thread.
+
+        cc -std=c11 -O2 -pthread -DADVENT_NO_MAIN advent.c steal.c tool.c
+
+    Needs C11 atomics; the rest of the engine is C99.
+*/
+
+#ifndef STEAL_H
+#define STEAL_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+struct steal_deque;
+
+struct steal_pool {
+    struct steal_deque *deques;         /* one for each worker */
+    int nworkers;
+    _Atomic uint64_t left;              /* tasks not handed out yet */
+};
+
+/* Set up POOL to hand out the tasks 0..NTASKS-1 to NWORKERS workers,
+   numbered 0..NWORKERS-1, each starting with an equal share. 0 on
+   success, -1 if out of memory. */
+int steal_init(struct steal_pool *pool, uint64_t ntasks, int nworkers);
+
+/* Free what steal_init() allocated, once the workers are done. */
+void steal_free(struct steal_pool *pool);
+
+/* The next task for worker W of POOL, stolen from another worker if W
+   has none left; -1 once every task has been handed out. Each worker
+   must only ever call it with its own W. */
+int64_t steal_next(struct steal_pool *pool, int w);
+
+#endif /* STEAL_H */